@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "hamming.h"
+
+/*
+    (64, 57) Hamming-Code benchmark suite
+    Sweeps working sets from L1 to DRAM, repeats each run and reports
+    median / p10 / p90 cycles per block for every noise profile.
+    Cycles are core cycles from perf counters when available, TSC ticks otherwise.
+    The cost of reading the clocks around an empty region is subtracted.
+*/
+
+/*  =============================
+ *      Cycle counter
+ *  ============================= */
+
+static int perf_fd = -1;
+static volatile struct perf_event_mmap_page* perf_page;
+
+static void cycles_init() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    perf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (perf_fd < 0)
+        return;
+    // The first page lets user space read the counter with rdpmc, no syscall
+    void* page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, perf_fd, 0);
+    if (page != MAP_FAILED)
+        perf_page = page;
+}
+
+static inline bool cycles_rdpmc() {
+    return perf_page && perf_page->cap_user_rdpmc;
+}
+
+static inline uint64_t cycles_now() {
+    if (perf_page) {
+        // Retry if the kernel updated the page while it was read
+        uint32_t seq, index;
+        uint64_t count;
+        do {
+            seq = perf_page->lock;
+            __asm__ volatile ("" ::: "memory");
+            index = perf_page->index;
+            count = perf_page->offset;
+            if (perf_page->cap_user_rdpmc && index) {
+                uint64_t width = perf_page->pmc_width;
+                int64_t pmc = __rdpmc(index - 1);
+                count += (int64_t)((uint64_t)pmc << (64 - width)) >> (64 - width);
+            }
+            __asm__ volatile ("" ::: "memory");
+        } while (perf_page->lock != seq);
+        if (perf_page->cap_user_rdpmc && index)
+            return count;
+    }
+    if (perf_fd >= 0) {
+        uint64_t count;
+        if (read(perf_fd, &count, sizeof(count)) == sizeof(count))
+            return count;
+    }
+    _mm_lfence();
+    uint64_t tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+}
+
+static inline double seconds_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*  =============================
+ *      Noise profiles
+ *  ============================= */
+
+typedef enum noise {
+    NOISE_NONE,
+    NOISE_SINGLE,       // One bit error in every block
+    NOISE_SINGLE_HALF,  // One bit error in a random half of the blocks
+    NOISE_SINGLE_SPARSE,// One bit error in one block out of 1000 on average
+    NOISE_DOUBLE,       // Two bit errors in every block
+    NOISE_BURST,        // An 8 bit burst in the stream every 64 blocks
+    NOISE_COUNT,
+} noise_t;
+
+const static char* noise_names[] = {
+    "none",
+    "single",
+    "single 50%",
+    "single 1e-3",
+    "double",
+    "burst 8/64",
+};
+
+static void add_noise(uint64_t* data, size_t count, noise_t noise, uint64_t* seed) {
+    switch (noise) {
+        case NOISE_NONE:
+            break;
+        case NOISE_SINGLE:
+            for (size_t i = 0; i < count; i++)
+                data[i] ^= 1ull << (generate_rand(seed) % 64);
+            break;
+        case NOISE_SINGLE_HALF:
+            for (size_t i = 0; i < count; i++)
+                if (generate_rand(seed) & 1)
+                    data[i] ^= 1ull << (generate_rand(seed) % 64);
+            break;
+        case NOISE_SINGLE_SPARSE:
+            for (size_t i = 0; i < count; i++)
+                if (generate_rand(seed) % 1000 == 0)
+                    data[i] ^= 1ull << (generate_rand(seed) % 64);
+            break;
+        case NOISE_DOUBLE:
+            for (size_t i = 0; i < count; i++) {
+                uint64_t pos1 = generate_rand(seed) % 64;
+                uint64_t pos2 = (pos1 + 1 + generate_rand(seed) % 63) % 64;
+                data[i] ^= (1ull << pos1) | (1ull << pos2);
+            }
+            break;
+        case NOISE_BURST:
+            for (size_t i = 0; i < count; i += 64) {
+                uint64_t start = i * 64 + generate_rand(seed) % (64 * 64);
+                for (uint64_t p = start; p < start + 8 && p < count * 64; p++)
+                    data[p / 64] ^= 1ull << (p % 64);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*  =============================
+ *      Kernels
+ *  ============================= */
+
+typedef enum kernel {
+    KERNEL_ENCODE,
+    KERNEL_DECODE,
+    KERNEL_DECODE_BITMAP,
+    KERNEL_DECODE_REPORT,
+    KERNEL_DECODE_TABLE,
+    KERNEL_COUNT,
+} kernel_t;
+
+const static char* kernel_names[] = {
+    "encode",
+    "decode",
+    "decode+bitmap",
+    "decode+stats",
+    "decode table",
+};
+
+static uint64_t* fail_bitmap;
+static decode_stats_t stats;
+
+static void run_kernel(kernel_t kernel, uint64_t* data, size_t count) {
+    switch (kernel) {
+        case KERNEL_ENCODE:
+            encode_batch(data, count);
+            break;
+        case KERNEL_DECODE:
+            decode_batch(data, count);
+            break;
+        case KERNEL_DECODE_BITMAP:
+            decode_batch_report(data, count, fail_bitmap, NULL);
+            break;
+        case KERNEL_DECODE_REPORT:
+            decode_batch_report(data, count, fail_bitmap, &stats);
+            break;
+        case KERNEL_DECODE_TABLE:
+            decode_batch_table(data, count);
+            break;
+        default:
+            break;
+    }
+}
+
+/*  =============================
+ *      Measurement
+ *  ============================= */
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, size_t n, double p) {
+    return sorted[(size_t)(p * (n - 1) + 0.5)];
+}
+
+// Clock reading cost inside a timed region, from runs of an empty region
+static double cycles_overhead, seconds_overhead;
+
+static void calibrate() {
+    const size_t reps = 1001;
+    double cycles[1001], seconds[1001];
+    for (size_t r = 0; r < reps; r++) {
+        double s_start = seconds_now();
+        uint64_t c_start = cycles_now();
+        __asm__ volatile ("" ::: "memory");
+        uint64_t c_end = cycles_now();
+        double s_end = seconds_now();
+        cycles[r] = (double)(c_end - c_start);
+        seconds[r] = s_end - s_start;
+    }
+    qsort(cycles, reps, sizeof(double), compare_double);
+    qsort(seconds, reps, sizeof(double), compare_double);
+    cycles_overhead = percentile(cycles, reps, 0.5);
+    seconds_overhead = percentile(seconds, reps, 0.5);
+}
+
+// Time one kernel over a working set, input restored from template before each run
+static void measure(kernel_t kernel, uint64_t* data, const uint64_t* template, size_t count, size_t reps, double* cycles, double* seconds) {
+    for (size_t r = 0; r < reps; r++) {
+        memcpy(data, template, count * sizeof(uint64_t));
+        double s_start = seconds_now();
+        uint64_t c_start = cycles_now();
+        run_kernel(kernel, data, count);
+        uint64_t c_end = cycles_now();
+        double s_end = seconds_now();
+        cycles[r] = ((double)(c_end - c_start) - cycles_overhead) / count;
+        seconds[r] = s_end - s_start - seconds_overhead;
+    }
+    qsort(cycles, reps, sizeof(double), compare_double);
+    qsort(seconds, reps, sizeof(double), compare_double);
+}
+
+int main() {
+    uint64_t seed = 88172645463325252ull;
+    cycles_init();
+    calibrate();
+    decode_table_init();
+#ifdef __HARDWARE_POPCNT__
+    printf("Popcount: hardware\n");
+#else
+    printf("Popcount: software\n");
+#endif
+    printf("Cycle source: %s\n", cycles_rdpmc() ? "perf core cycles (rdpmc)"
+        : perf_fd >= 0 ? "perf core cycles (read)" : "rdtsc (reference cycles)");
+    printf("Timer overhead: %.0lf cycles, %.0lf ns per run, subtracted\n", cycles_overhead, seconds_overhead * 1e9);
+
+    // 16 KiB (L1) .. 256 MiB (DRAM)
+    const size_t max_bytes = 256ull << 20;
+    const size_t max_count = max_bytes / sizeof(uint64_t);
+    uint64_t* original = malloc(max_bytes);
+    uint64_t* encoded = malloc(max_bytes);
+    uint64_t* template = malloc(max_bytes);
+    uint64_t* data = malloc(max_bytes);
+    fail_bitmap = malloc((max_count + 63) / 64 * sizeof(uint64_t));
+
+    for (size_t i = 0; i < max_count; i++)
+        original[i] = generate_rand(&seed) % (1ull << 57);
+    memcpy(encoded, original, max_bytes);
+    encode_batch(encoded, max_count);
+
+    const size_t max_reps = 501;
+    double* cycles = malloc(max_reps * sizeof(double));
+    double* seconds = malloc(max_reps * sizeof(double));
+
+    printf("%10s %-13s %-11s %10s %10s %10s %12s\n",
+        "set", "kernel", "noise", "cyc p50", "cyc p10", "cyc p90", "MiB/s p50");
+    for (size_t bytes = 16 << 10; bytes <= max_bytes; bytes <<= 2) {
+        size_t count = bytes / sizeof(uint64_t);
+        // Keep roughly 2^25 blocks per configuration, at least 7 runs
+        size_t reps = (1ull << 25) / count;
+        reps = reps < 7 ? 7 : reps > max_reps ? max_reps : reps;
+        double megabytes = count * 57.0 / 8.0 / 1024.0 / 1024.0;
+
+        for (kernel_t kernel = 0; kernel < KERNEL_COUNT; kernel++) {
+            for (noise_t noise = 0; noise < NOISE_COUNT; noise++) {
+                // Noise only matters to decoding
+                if (kernel == KERNEL_ENCODE && noise != NOISE_NONE)
+                    continue;
+                if (kernel == KERNEL_ENCODE) {
+                    memcpy(template, original, bytes);
+                } else {
+                    memcpy(template, encoded, bytes);
+                    add_noise(template, count, noise, &seed);
+                }
+                memset(&stats, 0, sizeof(stats));
+                measure(kernel, data, template, count, reps, cycles, seconds);
+                printf("%7zu KiB %-13s %-11s %10.2lf %10.2lf %10.2lf %12.1lf\n",
+                    bytes >> 10, kernel_names[kernel], noise_names[noise],
+                    percentile(cycles, reps, 0.5), percentile(cycles, reps, 0.1), percentile(cycles, reps, 0.9),
+                    megabytes / percentile(seconds, reps, 0.5));
+            }
+        }
+    }
+
+    // Reporting overhead, paired: decode, decode+bitmap and decode+stats run back
+    // to back on the same input each round, so clock and cache drift cancel.
+    // The target is under 5% at the production-like 1e-3 error rate.
+    printf("\nReporting overhead over plain decode, percentiles of per-round ratios\n");
+    printf("%10s %-11s %-13s %9s %9s %9s\n", "set", "noise", "kernel", "p50", "p10", "p90");
+    const noise_t overhead_noises[] = {NOISE_SINGLE, NOISE_SINGLE_SPARSE};
+    const kernel_t overhead_kernels[] = {KERNEL_DECODE_BITMAP, KERNEL_DECODE_REPORT};
+    double* ratios[2] = {malloc(max_reps * sizeof(double)), malloc(max_reps * sizeof(double))};
+    for (size_t bytes = 256 << 10; bytes <= max_bytes; bytes <<= 4) {
+        size_t count = bytes / sizeof(uint64_t);
+        size_t reps = (1ull << 26) / count;
+        reps = reps < 15 ? 15 : reps > max_reps ? max_reps : reps;
+        for (size_t n = 0; n < 2; n++) {
+            memcpy(template, encoded, bytes);
+            add_noise(template, count, overhead_noises[n], &seed);
+            // Each sample is the fastest of 3 back-to-back runs, to drop preempted runs
+            for (size_t r = 0; r < reps; r++) {
+                double base[3], run[3];
+                measure(KERNEL_DECODE, data, template, count, 3, base, seconds);
+                for (size_t k = 0; k < 2; k++) {
+                    memset(&stats, 0, sizeof(stats));
+                    measure(overhead_kernels[k], data, template, count, 3, run, seconds);
+                    ratios[k][r] = run[0] / base[0] - 1.0;
+                }
+            }
+            for (size_t k = 0; k < 2; k++) {
+                qsort(ratios[k], reps, sizeof(double), compare_double);
+                printf("%7zu KiB %-11s %-13s %+8.2lf%% %+8.2lf%% %+8.2lf%%\n",
+                    bytes >> 10, noise_names[overhead_noises[n]], kernel_names[overhead_kernels[k]],
+                    100.0 * percentile(ratios[k], reps, 0.5), 100.0 * percentile(ratios[k], reps, 0.1),
+                    100.0 * percentile(ratios[k], reps, 0.9));
+            }
+        }
+    }
+    free(ratios[0]);
+    free(ratios[1]);
+
+    free(seconds);
+    free(cycles);
+    free(fail_bitmap);
+    free(data);
+    free(template);
+    free(encoded);
+    free(original);
+    return 0;
+}
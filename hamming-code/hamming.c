@@ -2,143 +2,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdlib.h>
+#include <time.h>
 #include <malloc.h>
 #include <sys/time.h>
 
-/*
-    (64, 57) Hamming-Code
-    0, 1, 2, 4, 8, 16, 32
-*/
-
-#define __HARDWARE_POPCNT__
-#define __FAST_MULTIPLE__
-
-#ifdef __HARDWARE_POPCNT__
-//  https://github.com/kimwalisch/libpopcnt/blob/master/libpopcnt.h#L190
-static inline uint64_t popcnt64(uint64_t x) {
-    __asm__ ("popcnt %1, %0" : "=r" (x) : "0" (x));
-    return x;
-}
-#else
-//  https://en.wikipedia.org/wiki/Hamming_weight
-const uint64_t m1  = 0x5555555555555555; //binary: 0101...
-const uint64_t m2  = 0x3333333333333333; //binary: 00110011..
-const uint64_t m4  = 0x0f0f0f0f0f0f0f0f; //binary:  4 zeros,  4 ones ...
-const uint64_t m8  = 0x00ff00ff00ff00ff; //binary:  8 zeros,  8 ones ...
-const uint64_t m16 = 0x0000ffff0000ffff; //binary: 16 zeros, 16 ones ...
-const uint64_t m32 = 0x00000000ffffffff; //binary: 32 zeros, 32 ones
-const uint64_t h01 = 0x0101010101010101; //the sum of 256 to the power of 0,1,2,3...
-
-#ifdef __FAST_MULTIPLE__
-static inline uint64_t popcnt64(uint64_t x)
-{
-    x -= (x >> 1) & m1;             //put count of each 2 bits into those 2 bits
-    x = (x & m2) + ((x >> 2) & m2); //put count of each 4 bits into those 4 bits 
-    x = (x + (x >> 4)) & m4;        //put count of each 8 bits into those 8 bits 
-    return (x * h01) >> 56;  //returns left 8 bits of x + (x<<8) + (x<<16) + (x<<24) + ... 
-}
-#else
-uint64_t popcnt64(uint64_t x)
-{
-    x -= (x >> 1) & m1;             //put count of each 2 bits into those 2 bits
-    x = (x & m2) + ((x >> 2) & m2); //put count of each 4 bits into those 4 bits 
-    x = (x + (x >> 4)) & m4;        //put count of each 8 bits into those 8 bits 
-    x += x >>  8;  //put count of each 16 bits into their lowest 8 bits
-    x += x >> 16;  //put count of each 32 bits into their lowest 8 bits
-    x += x >> 32;  //put count of each 64 bits into their lowest 8 bits
-    return x & 0x7f;
-}
-#endif
-#endif
-
-static inline uint64_t generate_rand (uint64_t* state) {
-    uint64_t x = *state;
-	x ^= x << 13;
-	x ^= x >> 7;
-	x ^= x << 17;
-	return *state = x;
-}
-
-const static uint64_t masks[] = {
-    0xAAAAAAAAAAAAAAAA,
-    0xCCCCCCCCCCCCCCCC,
-    0xF0F0F0F0F0F0F0F0,
-    0xFF00FF00FF00FF00,
-    0xFFFF0000FFFF0000,
-    0xFFFFFFFF00000000,
-};
-
-// Reposition data
-static inline uint64_t reposition(uint64_t x) {
-    return 
-        (x & (0x00000001ull <<  0)) << 3 |   // Skip 0, 1, 2
-        (x & (0x00000007ull <<  1)) << 4 |   // Skip 4
-        (x & (0x0000007Full <<  4)) << 5 |   // Skip 8
-        (x & (0x00007FFFull << 11)) << 6 |   // Skip 16
-        (x & (0x7FFFFFFFull << 26)) << 7;    // Skip 32
-}
-
-// Un-reposition data
-static inline uint64_t unreposition(uint64_t x) {
-    return
-        (x & (0x00000001ull <<  3)) >> 3 |
-        (x & (0x00000007ull <<  5)) >> 4 |
-        (x & (0x0000007Full <<  9)) >> 5 |
-        (x & (0x00007FFFull << 17)) >> 6 |
-        (x & (0x7FFFFFFFull << 33)) >> 7;
-}
-
-// Set parity
-static inline uint64_t set_parity(uint64_t x) {
-    x ^= ((popcnt64(x & masks[0]) & 1) << (1ull << 0)); // Set 1
-    x ^= ((popcnt64(x & masks[1]) & 1) << (1ull << 1)); // Set 2
-    x ^= ((popcnt64(x & masks[2]) & 1) << (1ull << 2)); // Set 4
-    x ^= ((popcnt64(x & masks[3]) & 1) << (1ull << 3)); // Set 8
-    x ^= ((popcnt64(x & masks[4]) & 1) << (1ull << 4)); // Set 16
-    x ^= ((popcnt64(x & masks[5]) & 1) << (1ull << 5)); // Set 32
-    x ^= popcnt64(x) & 1; // Set 0 (extend bit)
-    return x;
-}
-
-// Find position
-static inline uint64_t find_error_position(uint64_t x) {
-    return
-        (popcnt64(x & masks[0]) & 1) << 0 |
-        (popcnt64(x & masks[1]) & 1) << 1 |
-        (popcnt64(x & masks[2]) & 1) << 2 |
-        (popcnt64(x & masks[3]) & 1) << 3 |
-        (popcnt64(x & masks[4]) & 1) << 4 |
-        (popcnt64(x & masks[5]) & 1) << 5;
-}
-
-// Correct block, return true if success
-static inline bool correct_block(uint64_t* x) {
-    uint64_t ep = find_error_position(*x);
-    // Found 1 error
-    if (popcnt64(*x) & 1) {
-        *x ^= (1ull << ep);
-        return true;
-    } else if (!ep) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
-// Encode a block
-static inline uint64_t encode(uint64_t x) {
-    return set_parity(reposition(x));
-}
-
-// Decode a block, return true if success
-static inline bool decode(uint64_t* x) {
-    if (correct_block(x)) {
-        *x = unreposition(*x);
-        return true;
-    } else {
-        return false;
-    }
-}
+#include "hamming.h"
+#include "hamming_gen.h"
 
 void print_binary(uint64_t x) {
     for (uint64_t i = 0; i < 64; i++) {
@@ -222,6 +92,336 @@ bool test() {
     return true;
 }
 
+// Same checks as test(), for every generated width
+#define HAMMING_TEST(name, type)                                                \
+bool test_##name() {                                                            \
+    struct timeval rand_time;                                                   \
+    gettimeofday(&rand_time, NULL);                                             \
+    uint64_t seed = rand_time.tv_sec * 1000000 + rand_time.tv_usec;             \
+    const uint128_t limit = ((uint128_t)1 << name##_data_bits) - 1;             \
+    for (size_t i = 0; i < 10000; i++) {                                        \
+        uint128_t random = (uint128_t)generate_rand(&seed) << 64 | generate_rand(&seed); \
+        type data = (type)(random & limit);                                     \
+                                                                                \
+        type blocked_data = name##_encode(data);                                \
+        if (name##_unreposition(blocked_data) != data) {                        \
+            printf("(%d, %d) reposition unmatch on %llu\n",                     \
+                name##_block_bits, name##_data_bits, i);                        \
+            return false;                                                       \
+        }                                                                       \
+                                                                                \
+        uint64_t err_pos = generate_rand(&seed) % name##_block_bits;            \
+        type err1_data = blocked_data ^ ((type)1 << err_pos);                   \
+        uint64_t found_err_pos = name##_find_error_position(err1_data);         \
+        if (err_pos != found_err_pos) {                                         \
+            printf("(%d, %d) error pos: %llu (found %llu)\n",                   \
+                name##_block_bits, name##_data_bits, err_pos, found_err_pos);   \
+            return false;                                                       \
+        }                                                                       \
+                                                                                \
+        if (!name##_decode(&err1_data)) {                                       \
+            printf("(%d, %d) decode failed on %llu\n",                          \
+                name##_block_bits, name##_data_bits, i);                        \
+            return false;                                                       \
+        } else if (err1_data != data) {                                         \
+            printf("(%d, %d) decode unmatch on %llu\n",                         \
+                name##_block_bits, name##_data_bits, i);                        \
+            return false;                                                       \
+        }                                                                       \
+                                                                                \
+        uint64_t err_pos1 = generate_rand(&seed) % name##_block_bits;           \
+        uint64_t err_pos2 = err_pos1;                                           \
+        while (err_pos2 == err_pos1)                                            \
+            err_pos2 = generate_rand(&seed) % name##_block_bits;                \
+        type unrecoverable = blocked_data ^ ((type)1 << err_pos1) ^ ((type)1 << err_pos2); \
+        if (name##_decode(&unrecoverable) != false) {                           \
+            printf("(%d, %d) decode success but expeced failed on %llu\n",      \
+                name##_block_bits, name##_data_bits, i);                        \
+            return false;                                                       \
+        }                                                                       \
+    }                                                                           \
+    return true;                                                                \
+}
+
+// Encode / decode throughput over 128 MiB of blocks, one bit error per block
+#define HAMMING_BENCH(name, type)                                               \
+void bench_##name(uint64_t* seed) {                                             \
+    uint64_t count = (128ull << 20) / sizeof(type);                             \
+    double megabytes = count * (double)name##_data_bits / 8.0 / 1024.0 / 1024.0; \
+    const uint128_t limit = ((uint128_t)1 << name##_data_bits) - 1;             \
+    type* data = malloc(count * sizeof(type));                                  \
+    for (uint64_t i = 0; i < count; i++) {                                      \
+        uint128_t random = (uint128_t)generate_rand(seed) << 64 | generate_rand(seed); \
+        data[i] = (type)(random & limit);                                       \
+    }                                                                           \
+                                                                                \
+    struct timeval t_start, t_end;                                              \
+    double encode_milis, decode_milis;                                          \
+    gettimeofday(&t_start, NULL);                                               \
+    for (uint64_t i = 0; i < count; i++)                                        \
+        data[i] = name##_encode(data[i]);                                       \
+    gettimeofday(&t_end, NULL);                                                 \
+    encode_milis = 1000.0 * (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_usec - t_start.tv_usec) / 1000.0; \
+                                                                                \
+    for (uint64_t i = 0; i < count; i++)                                        \
+        data[i] ^= (type)1 << (generate_rand(seed) % name##_block_bits);        \
+                                                                                \
+    uint64_t failed = 0;                                                        \
+    gettimeofday(&t_start, NULL);                                               \
+    for (uint64_t i = 0; i < count; i++)                                        \
+        failed += !name##_decode(&data[i]);                                     \
+    gettimeofday(&t_end, NULL);                                                 \
+    decode_milis = 1000.0 * (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_usec - t_start.tv_usec) / 1000.0; \
+                                                                                \
+    printf("(%3d, %3d) encode: %10.3lf MiB/s, decode: %10.3lf MiB/s, %llu failed\n", \
+        name##_block_bits, name##_data_bits,                                    \
+        1000.0 * megabytes / encode_milis, 1000.0 * megabytes / decode_milis, failed); \
+    free(data);                                                                 \
+}
+
+HAMMING_TEST(h8_4,     uint8_t)
+HAMMING_TEST(h16_11,   uint16_t)
+HAMMING_TEST(h32_26,   uint32_t)
+HAMMING_TEST(h64_57,   uint64_t)
+HAMMING_TEST(h128_120, uint128_t)
+
+HAMMING_BENCH(h8_4,     uint8_t)
+HAMMING_BENCH(h16_11,   uint16_t)
+HAMMING_BENCH(h32_26,   uint32_t)
+HAMMING_BENCH(h64_57,   uint64_t)
+HAMMING_BENCH(h128_120, uint128_t)
+
+
+// Table decoder must agree with decode() on clean, single and double error blocks
+bool test_decode_table() {
+    struct timeval rand_time;
+    gettimeofday(&rand_time, NULL);
+    uint64_t seed = rand_time.tv_sec * 1000000 + rand_time.tv_usec;
+    decode_table_init();
+    for (size_t i = 0; i < 10000; i++) {
+        uint64_t data = generate_rand(&seed) % (1ull << 57);
+        uint64_t block = encode(data);
+        for (int errors = 0; errors <= 2; errors++) {
+            if (syndrome_lookup(block) != syndrome(block)) {
+                printf("Syndrome lookup unmatch on %llu: %llu\n", i, block);
+                return false;
+            }
+            uint64_t expected = block, actual = block;
+            bool expected_ok = decode(&expected);
+            bool actual_ok = decode_table(&actual);
+            if (expected_ok != actual_ok || expected != actual) {
+                printf("Table decode unmatch on %llu with %d errors: %llu\n", i, errors, block);
+                return false;
+            }
+            block ^= 1ull << (generate_rand(&seed) % 64);
+        }
+    }
+    return true;
+}
+// Bursts of up to depth bits anywhere in the interleaved stream must be corrected
+bool test_interleave() {
+    struct timeval rand_time;
+    gettimeofday(&rand_time, NULL);
+    uint64_t seed = rand_time.tv_sec * 1000000 + rand_time.tv_usec;
+    uint64_t original[64 * 4 + 32];
+    uint64_t data[64 * 4 + 32];
+    for (size_t depth = 1; depth <= 64; depth <<= 1) {
+        // Full groups only, full groups and a tail, a single group and a tail,
+        // and fewer blocks than depth, which only guarantees count bits
+        const size_t counts[] = {depth * 4, depth * 4 + depth / 2, depth + 1, depth + depth / 2, depth * 2 - 1, depth / 2};
+        for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+            size_t count = counts[k];
+            if (!count)
+                continue;
+            size_t max_length = count < depth ? count : depth;
+            for (size_t i = 0; i < 1000; i++) {
+                for (size_t j = 0; j < count; j++)
+                    original[j] = generate_rand(&seed) % (1ull << 57);
+                memcpy(data, original, count * sizeof(uint64_t));
+                encode_interleaved(data, count, depth);
+
+                // Longest bursts half the time, anywhere in the stream including the tail
+                uint64_t length = i % 2 ? max_length : 1 + generate_rand(&seed) % max_length;
+                uint64_t start = generate_rand(&seed) % (count * 64 - length + 1);
+                for (uint64_t p = start; p < start + length; p++)
+                    data[p / 64] ^= 1ull << (p % 64);
+
+                size_t failed = decode_interleaved(data, count, depth);
+                if (failed || memcmp(data, original, count * sizeof(uint64_t))) {
+                    printf("Interleave depth %llu, %llu blocks: burst of %llu at bit %llu not corrected\n",
+                        depth, count, length, start);
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Unsupported depths round down to a power of two in 1..64
+    const size_t invalid[] = {0, 3, 6, 100};
+    const size_t rounded[] = {1, 2, 4, 64};
+    uint64_t expected[64 * 4 + 32];
+    for (size_t k = 0; k < sizeof(invalid) / sizeof(invalid[0]); k++) {
+        size_t count = 64 * 4 + 5;
+        for (size_t j = 0; j < count; j++)
+            original[j] = generate_rand(&seed) % (1ull << 57);
+        memcpy(data, original, count * sizeof(uint64_t));
+        memcpy(expected, original, count * sizeof(uint64_t));
+        encode_interleaved(data, count, invalid[k]);
+        encode_interleaved(expected, count, rounded[k]);
+        bool same = memcmp(data, expected, count * sizeof(uint64_t)) == 0;
+        size_t failed = decode_interleaved(data, count, invalid[k]);
+        if (!same || failed || memcmp(data, original, count * sizeof(uint64_t))) {
+            printf("Interleave depth %llu: round trip failed\n", invalid[k]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static double interleave_now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Interleaved encode / decode cost over plain encode_batch / decode_batch
+// Both decoders see one error per block: a random bit for the plain stream,
+// one burst of depth bits per group for the interleaved one. Runs alternate
+// and the fastest of each is kept, in a cache resident buffer and in DRAM.
+void bench_interleave(uint64_t* seed) {
+    const uint64_t counts[] = {4096, 1 << 24};
+    const size_t rounds[] = {2001, 3};
+    const size_t depths[] = {1, 4, 16, 64};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint64_t count = counts[c];
+        uint64_t* original = malloc(count * sizeof(uint64_t));
+        uint64_t* plain = malloc(count * sizeof(uint64_t));
+        uint64_t* interleaved = malloc(count * sizeof(uint64_t));
+        uint64_t* data = malloc(count * sizeof(uint64_t));
+        for (uint64_t i = 0; i < count; i++)
+            original[i] = generate_rand(seed) % (1ull << 57);
+        memcpy(plain, original, count * sizeof(uint64_t));
+        encode_batch(plain, count);
+        for (uint64_t i = 0; i < count; i++)
+            plain[i] ^= 1ull << (generate_rand(seed) % 64);
+
+        printf("%llu blocks (%llu KiB):\n", count, count * sizeof(uint64_t) / 1024);
+        for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+            size_t depth = depths[d];
+            memcpy(interleaved, original, count * sizeof(uint64_t));
+            encode_interleaved(interleaved, count, depth);
+            for (uint64_t i = 0; i < count; i += depth) {
+                uint64_t start = i * 64 + generate_rand(seed) % (depth * 64 - depth + 1);
+                for (uint64_t p = start; p < start + depth; p++)
+                    interleaved[p / 64] ^= 1ull << (p % 64);
+            }
+
+            double best[4] = {1e9, 1e9, 1e9, 1e9};
+            size_t failed = 0;
+            for (size_t r = 0; r < rounds[c]; r++) {
+                double t[4];
+                memcpy(data, original, count * sizeof(uint64_t));
+                t[0] = interleave_now();
+                encode_batch(data, count);
+                t[0] = interleave_now() - t[0];
+                memcpy(data, original, count * sizeof(uint64_t));
+                t[1] = interleave_now();
+                encode_interleaved(data, count, depth);
+                t[1] = interleave_now() - t[1];
+                memcpy(data, plain, count * sizeof(uint64_t));
+                t[2] = interleave_now();
+                failed += decode_batch(data, count);
+                t[2] = interleave_now() - t[2];
+                memcpy(data, interleaved, count * sizeof(uint64_t));
+                t[3] = interleave_now();
+                failed += decode_interleaved(data, count, depth);
+                t[3] = interleave_now() - t[3];
+                for (int k = 0; k < 4; k++)
+                    if (t[k] < best[k])
+                        best[k] = t[k];
+            }
+            printf("Depth %2llu encode: %6.2lf ns/block (%+6.1lf%%), decode: %6.2lf ns/block (%+6.1lf%%), %llu failed\n",
+                depth, best[1] / count * 1e9, 100.0 * (best[1] / best[0] - 1),
+                best[3] / count * 1e9, 100.0 * (best[3] / best[2] - 1), failed);
+        }
+        free(original);
+        free(plain);
+        free(interleaved);
+        free(data);
+    }
+}
+
+// Cost of the failure bitmap and syndrome counters over the plain decode kernel
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double time_decode_report(uint64_t* data, const uint64_t* noisy, uint64_t count, uint64_t* fail_bitmap, decode_stats_t* stats, bool report) {
+    struct timespec t_start, t_end;
+    memcpy(data, noisy, count * sizeof(uint64_t));
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    if (report)
+        decode_batch_report(data, count, fail_bitmap, stats);
+    else
+        decode_batch(data, count);
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    return 1000.0 * (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e6;
+}
+
+// Overhead is the median of per-round ratios, all three variants run back to
+// back each round. bench.o measures it across working sets with cycle counts.
+void bench_decode_report_noise(const uint64_t* noisy, uint64_t count) {
+    enum { ROUNDS = 15 };
+    double megabytes = count * 57.0 / 8.0 / 1024.0 / 1024.0;
+    uint64_t* data = malloc(count * sizeof(uint64_t));
+    uint64_t* fail_bitmap = malloc((count + 63) / 64 * sizeof(uint64_t));
+    decode_stats_t* stats = malloc(sizeof(decode_stats_t));
+    double plain[ROUNDS], bitmap[ROUNDS], with_stats[ROUNDS];
+
+    for (int round = 0; round < ROUNDS; round++) {
+        plain[round] = time_decode_report(data, noisy, count, NULL, NULL, false);
+        bitmap[round] = time_decode_report(data, noisy, count, fail_bitmap, NULL, true) / plain[round];
+        memset(stats, 0, sizeof(decode_stats_t));
+        with_stats[round] = time_decode_report(data, noisy, count, fail_bitmap, stats, true) / plain[round];
+    }
+    qsort(plain, ROUNDS, sizeof(double), compare_double);
+    qsort(bitmap, ROUNDS, sizeof(double), compare_double);
+    qsort(with_stats, ROUNDS, sizeof(double), compare_double);
+
+    printf("Plain decode:           %10.3lf MiB/s\n", 1000.0 * megabytes / plain[ROUNDS / 2]);
+    printf("Decode + bitmap:        %+9.2lf%% (median of %d paired rounds)\n", 100.0 * (bitmap[ROUNDS / 2] - 1.0), ROUNDS);
+    printf("Decode + bitmap, stats: %+9.2lf%% (median of %d paired rounds)\n", 100.0 * (with_stats[ROUNDS / 2] - 1.0), ROUNDS);
+    printf("Corrected %llu, uncorrectable %llu, clean %llu\n",
+        decode_stats_corrected(stats), decode_stats_uncorrectable(stats), decode_stats_syndrome(stats, 0));
+
+    uint64_t hottest = 0;
+    for (uint64_t pos = 1; pos < 64; pos++)
+        if (decode_stats_position(stats, pos) > decode_stats_position(stats, hottest))
+            hottest = pos;
+    printf("Most corrected bit position: %llu (%llu times)\n", hottest, decode_stats_position(stats, hottest));
+
+    free(stats);
+    free(fail_bitmap);
+    free(data);
+}
+
+// Report overhead with an error in every block, and at a production-like rate
+void bench_decode_report(const uint64_t* noisy, const uint64_t* original, uint64_t count, uint64_t* seed) {
+    printf("One error per block:\n");
+    bench_decode_report_noise(noisy, count);
+
+    uint64_t* sparse = malloc(count * sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; i++) {
+        sparse[i] = encode(original[i]);
+        if (generate_rand(seed) % 1000 == 0)
+            sparse[i] ^= 1ull << (generate_rand(seed) % 64);
+    }
+    printf("One error per 1000 blocks:\n");
+    bench_decode_report_noise(sparse, count);
+    free(sparse);
+}
+
 int main() {
     printf("Running tests on random data...\n");
 
@@ -234,6 +434,21 @@ int main() {
         return 0;
     }
 
+    if (!test_h8_4() || !test_h16_11() || !test_h32_26() || !test_h64_57() || !test_h128_120()) {
+        printf("Generated code test FAIL.\n");
+        return 0;
+    }
+
+    if (!test_decode_table()) {
+        printf("Table decode test FAIL.\n");
+        return 0;
+    }
+
+    if (!test_interleave()) {
+        printf("Interleave test FAIL.\n");
+        return 0;
+    }
+
     printf("Test PASS. Preparing performance bench...\n");
     uint64_t count = 1 << 24;
     double megabytes = count * 57.0 / 8.0 / 1024.0 / 1024.0;
@@ -263,22 +478,25 @@ int main() {
         data[i] ^= (1ull << err_pos);
     }
     uint64_t extra_error_i = generate_rand(&seed) % count;
-    uint64_t extra_error_pos = generate_rand(&seed) % count;
+    uint64_t extra_error_pos = generate_rand(&seed) % 64;
     printf("Added extra noise on block %llu.\n", extra_error_i);
     data[extra_error_i] ^= (1ull << extra_error_pos);
 
+    uint64_t* noisy = malloc(count * sizeof(uint64_t));
+    memcpy(noisy, data, count * sizeof(uint64_t));
+    uint64_t* fail_bitmap = malloc((count + 63) / 64 * sizeof(uint64_t));
+
     printf("Running decode benchmark...\n");
     gettimeofday(&t_start, NULL);
-    for (uint64_t i = 0; i < count; i++) {
-        if (!decode(&data[i])) {
-            printf("Decode failed on %llu block!\n", i);
-            continue;
-        }
-    }
+    decode_batch_report(data, count, fail_bitmap, NULL);
     gettimeofday(&t_end, NULL);
     milis = 1000.0 * (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_usec - t_start.tv_usec) / 1000.0;
     printf("Decode benchmark run complete. %.3lf MiB in %.3lf ms.\n", megabytes, milis);
     printf("Decode speed: %.3lf MiB/s\n", 1000.0 * megabytes / milis);
+    for (uint64_t i = 0; i < count; i++) {
+        if (fail_bitmap[i / 64] >> (i % 64) & 1)
+            printf("Decode failed on %llu block!\n", i);
+    }
     printf("Checking results...\n");
     for (uint64_t i = 0; i < count; i++) {
         if (original[i] != data[i]) {
@@ -290,6 +508,21 @@ int main() {
         }
     }
 
+    printf("Running decode report benchmark...\n");
+    bench_decode_report(noisy, original, count, &seed);
+    free(noisy);
+    free(fail_bitmap);
+
+    printf("Running generated code benchmark...\n");
+    bench_h8_4(&seed);
+    bench_h16_11(&seed);
+    bench_h32_26(&seed);
+    bench_h64_57(&seed);
+    bench_h128_120(&seed);
+
+    printf("Running interleave benchmark...\n");
+    bench_interleave(&seed);
+
     printf("Benchmark completed.\n");
 
     return 0;
@@ -0,0 +1,582 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+    (64, 57) Hamming-Code
+    0, 1, 2, 4, 8, 16, 32
+*/
+
+// Build with -D__SOFTWARE_POPCNT__ for hosts without a fast popcnt
+#ifndef __SOFTWARE_POPCNT__
+#define __HARDWARE_POPCNT__
+#endif
+#define __FAST_MULTIPLE__
+
+#ifdef __HARDWARE_POPCNT__
+//  https://github.com/kimwalisch/libpopcnt/blob/master/libpopcnt.h#L190
+static inline uint64_t popcnt64(uint64_t x) {
+    __asm__ ("popcnt %1, %0" : "=r" (x) : "0" (x));
+    return x;
+}
+#else
+//  https://en.wikipedia.org/wiki/Hamming_weight
+static const uint64_t m1  = 0x5555555555555555; //binary: 0101...
+static const uint64_t m2  = 0x3333333333333333; //binary: 00110011..
+static const uint64_t m4  = 0x0f0f0f0f0f0f0f0f; //binary:  4 zeros,  4 ones ...
+static const uint64_t m8  = 0x00ff00ff00ff00ff; //binary:  8 zeros,  8 ones ...
+static const uint64_t m16 = 0x0000ffff0000ffff; //binary: 16 zeros, 16 ones ...
+static const uint64_t m32 = 0x00000000ffffffff; //binary: 32 zeros, 32 ones
+static const uint64_t h01 = 0x0101010101010101; //the sum of 256 to the power of 0,1,2,3...
+
+#ifdef __FAST_MULTIPLE__
+static inline uint64_t popcnt64(uint64_t x)
+{
+    x -= (x >> 1) & m1;             //put count of each 2 bits into those 2 bits
+    x = (x & m2) + ((x >> 2) & m2); //put count of each 4 bits into those 4 bits 
+    x = (x + (x >> 4)) & m4;        //put count of each 8 bits into those 8 bits 
+    return (x * h01) >> 56;  //returns left 8 bits of x + (x<<8) + (x<<16) + (x<<24) + ... 
+}
+#else
+static inline uint64_t popcnt64(uint64_t x)
+{
+    x -= (x >> 1) & m1;             //put count of each 2 bits into those 2 bits
+    x = (x & m2) + ((x >> 2) & m2); //put count of each 4 bits into those 4 bits 
+    x = (x + (x >> 4)) & m4;        //put count of each 8 bits into those 8 bits 
+    x += x >>  8;  //put count of each 16 bits into their lowest 8 bits
+    x += x >> 16;  //put count of each 32 bits into their lowest 8 bits
+    x += x >> 32;  //put count of each 64 bits into their lowest 8 bits
+    return x & 0x7f;
+}
+#endif
+#endif
+
+static inline uint64_t generate_rand (uint64_t* state) {
+    uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+const static uint64_t masks[] = {
+    0xAAAAAAAAAAAAAAAA,
+    0xCCCCCCCCCCCCCCCC,
+    0xF0F0F0F0F0F0F0F0,
+    0xFF00FF00FF00FF00,
+    0xFFFF0000FFFF0000,
+    0xFFFFFFFF00000000,
+};
+
+// Reposition data
+static inline uint64_t reposition(uint64_t x) {
+    return 
+        (x & (0x00000001ull <<  0)) << 3 |   // Skip 0, 1, 2
+        (x & (0x00000007ull <<  1)) << 4 |   // Skip 4
+        (x & (0x0000007Full <<  4)) << 5 |   // Skip 8
+        (x & (0x00007FFFull << 11)) << 6 |   // Skip 16
+        (x & (0x7FFFFFFFull << 26)) << 7;    // Skip 32
+}
+
+// Un-reposition data
+static inline uint64_t unreposition(uint64_t x) {
+    return
+        (x & (0x00000001ull <<  3)) >> 3 |
+        (x & (0x00000007ull <<  5)) >> 4 |
+        (x & (0x0000007Full <<  9)) >> 5 |
+        (x & (0x00007FFFull << 17)) >> 6 |
+        (x & (0x7FFFFFFFull << 33)) >> 7;
+}
+
+// Set parity
+static inline uint64_t set_parity(uint64_t x) {
+    x ^= ((popcnt64(x & masks[0]) & 1) << (1ull << 0)); // Set 1
+    x ^= ((popcnt64(x & masks[1]) & 1) << (1ull << 1)); // Set 2
+    x ^= ((popcnt64(x & masks[2]) & 1) << (1ull << 2)); // Set 4
+    x ^= ((popcnt64(x & masks[3]) & 1) << (1ull << 3)); // Set 8
+    x ^= ((popcnt64(x & masks[4]) & 1) << (1ull << 4)); // Set 16
+    x ^= ((popcnt64(x & masks[5]) & 1) << (1ull << 5)); // Set 32
+    x ^= popcnt64(x) & 1; // Set 0 (extend bit)
+    return x;
+}
+
+// Find position
+static inline uint64_t find_error_position(uint64_t x) {
+    return
+        (popcnt64(x & masks[0]) & 1) << 0 |
+        (popcnt64(x & masks[1]) & 1) << 1 |
+        (popcnt64(x & masks[2]) & 1) << 2 |
+        (popcnt64(x & masks[3]) & 1) << 3 |
+        (popcnt64(x & masks[4]) & 1) << 4 |
+        (popcnt64(x & masks[5]) & 1) << 5;
+}
+
+// Correct block, return true if success
+static inline bool correct_block(uint64_t* x) {
+    uint64_t ep = find_error_position(*x);
+    // Found 1 error
+    if (popcnt64(*x) & 1) {
+        *x ^= (1ull << ep);
+        return true;
+    } else if (!ep) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+// Encode a block
+static inline uint64_t encode(uint64_t x) {
+    return set_parity(reposition(x));
+}
+
+// Decode a block, return true if success
+static inline bool decode(uint64_t* x) {
+    if (correct_block(x)) {
+        *x = unreposition(*x);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+// Encode blocks in place
+static inline void encode_batch(uint64_t* data, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        data[i] = encode(data[i]);
+}
+
+// Decode blocks in place, return number of uncorrectable blocks
+static inline size_t decode_batch(uint64_t* data, size_t count) {
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++)
+        failed += !decode(&data[i]);
+    return failed;
+}
+
+// Syndrome of a block: overall parity << 6 | error position
+// 0 is a clean block, 64..127 a single error at (syndrome - 64),
+// 1..63 an uncorrectable double error
+static inline uint64_t syndrome(uint64_t x) {
+    return (popcnt64(x) & 1) << 6 | find_error_position(x);
+}
+
+/*
+    Decode statistics
+    Only blocks with a nonzero syndrome are counted, clean blocks (the common
+    case) cost one predictable branch.
+*/
+typedef struct decode_stats {
+    uint64_t blocks;
+    uint64_t syndromes[128];
+} decode_stats_t;
+
+// Blocks seen with syndrome s
+static inline uint64_t decode_stats_syndrome(const decode_stats_t* stats, uint64_t s) {
+    if (s)
+        return stats->syndromes[s];
+    uint64_t clean = stats->blocks;
+    for (uint64_t t = 1; t < 128; t++)
+        clean -= stats->syndromes[t];
+    return clean;
+}
+
+// Single errors corrected at bit position pos
+static inline uint64_t decode_stats_position(const decode_stats_t* stats, uint64_t pos) {
+    return stats->syndromes[64 | pos];
+}
+
+static inline uint64_t decode_stats_corrected(const decode_stats_t* stats) {
+    uint64_t sum = 0;
+    for (uint64_t s = 64; s < 128; s++)
+        sum += stats->syndromes[s];
+    return sum;
+}
+
+static inline uint64_t decode_stats_uncorrectable(const decode_stats_t* stats) {
+    uint64_t sum = 0;
+    for (uint64_t s = 1; s < 64; s++)
+        sum += stats->syndromes[s];
+    return sum;
+}
+
+// Decode up to 64 blocks, return the bitmap of uncorrectable ones
+// Called with a constant count_stats, so each caller gets its own loop:
+// without stats it is decode() plus one shift and or per block, with stats
+// the counters are bumped inside the branches decode() already takes.
+static inline __attribute__((always_inline)) uint64_t decode_report_group(uint64_t* data, size_t n, decode_stats_t* stats, const bool count_stats) {
+    uint64_t fail_bits = 0;
+    for (size_t j = 0; j < n; j++) {
+        if (!count_stats) {
+            fail_bits |= (uint64_t)!decode(&data[j]) << j;
+            continue;
+        }
+        uint64_t x = data[j];
+        uint64_t ep = find_error_position(x);
+        if (popcnt64(x) & 1) {
+            stats->syndromes[64 | ep]++;
+            data[j] = unreposition(x ^ (1ull << ep));
+        } else if (!ep) {
+            data[j] = unreposition(x);
+        } else {
+            stats->syndromes[ep]++;
+            fail_bits |= 1ull << j;
+        }
+    }
+    return fail_bits;
+}
+
+// Decode blocks in place, return number of uncorrectable blocks
+// fail_bitmap: (count + 63) / 64 words, bit i set if block i is uncorrectable (may be NULL)
+// stats: accumulated per syndrome, zero it before the first call (may be NULL)
+// Uncorrectable blocks are left as received.
+static inline size_t decode_batch_report(uint64_t* data, size_t count, uint64_t* fail_bitmap, decode_stats_t* stats) {
+    size_t failed = 0;
+    for (size_t base = 0; base < count; base += 64) {
+        size_t n = count - base < 64 ? count - base : 64;
+        uint64_t fail_bits = stats ?
+            decode_report_group(data + base, n, stats, true) :
+            decode_report_group(data + base, n, NULL, false);
+        if (fail_bitmap)
+            fail_bitmap[base / 64] = fail_bits;
+        failed += popcnt64(fail_bits);
+    }
+    if (stats)
+        stats->blocks += count;
+    return failed;
+}
+
+/*
+    Table-driven decoder
+    The syndrome is the XOR of the positions of all set bits, with the overall
+    parity on bit 6, so it splits into one lookup per byte. Correction is a
+    second lookup by syndrome: the bit to flip, and a keep mask that is all
+    ones when the block is uncorrectable. No branch depends on the data.
+    Call decode_table_init() once before use.
+*/
+typedef struct correction {
+    uint64_t flip;
+    uint64_t keep;
+} correction_t;
+
+static uint8_t syndrome_table[8][256];
+static correction_t correction_table[128];
+
+static inline void decode_table_init() {
+    for (uint64_t byte = 0; byte < 8; byte++) {
+        for (uint64_t value = 0; value < 256; value++) {
+            uint8_t s = 0;
+            for (uint64_t bit = 0; bit < 8; bit++)
+                if (value >> bit & 1)
+                    s ^= 64 | (byte * 8 + bit);
+            syndrome_table[byte][value] = s;
+        }
+    }
+    for (uint64_t s = 0; s < 128; s++) {
+        correction_table[s].flip = (s & 64) ? 1ull << (s & 63) : 0;
+        correction_table[s].keep = (s != 0 && s < 64) ? ~0ull : 0;
+    }
+}
+
+// Same value as syndrome(), from 8 byte lookups
+static inline uint64_t syndrome_lookup(uint64_t x) {
+    return
+        syndrome_table[0][x       & 0xff] ^
+        syndrome_table[1][x >>  8 & 0xff] ^
+        syndrome_table[2][x >> 16 & 0xff] ^
+        syndrome_table[3][x >> 24 & 0xff] ^
+        syndrome_table[4][x >> 32 & 0xff] ^
+        syndrome_table[5][x >> 40 & 0xff] ^
+        syndrome_table[6][x >> 48 & 0xff] ^
+        syndrome_table[7][x >> 56];
+}
+
+// Decode a block, return true if success
+// Uncorrectable blocks are left as received.
+static inline bool decode_table(uint64_t* x) {
+    correction_t c = correction_table[syndrome_lookup(*x)];
+    *x = (*x & c.keep) | (unreposition(*x ^ c.flip) & ~c.keep);
+    return !(c.keep & 1);
+}
+
+// Decode blocks in place with the table decoder, return number of uncorrectable blocks
+static inline size_t decode_batch_table(uint64_t* data, size_t count) {
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i++) {
+        correction_t c = correction_table[syndrome_lookup(data[i])];
+        data[i] = (data[i] & c.keep) | (unreposition(data[i] ^ c.flip) & ~c.keep);
+        failed += c.keep & 1;
+    }
+    return failed;
+}
+
+/*
+    Block interleaving
+    Groups of D blocks (D = 1, 2, 4, ..., 64) are transposed as D x D bit
+    matrices, chunk by chunk: after interleaving, bit c * D + b of word r
+    is bit c * D + r of block b. Any D consecutive bits of the stream then
+    hit D different blocks, so a burst of up to D bits is one error per block.
+    Transposing is its own inverse.
+
+    When the count is not a multiple of D, the last full group and the tail
+    form one group of n blocks (D < n < 2D) interleaved with stride n: bit c
+    of block b is stream bit c * n + b. Any n consecutive bits hit n
+    different blocks, so the tail keeps the full D-bit guarantee. Fewer than
+    D blocks in total are interleaved with stride count and tolerate bursts
+    of up to count bits; no layout can do better, a longer burst must hit
+    some block twice.
+*/
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+// One swap pass between whole vectors of 4 rows, j = 4..32
+static inline __attribute__((always_inline)) void interleave_pass_avx2(__m256i* v, const size_t n, const int j) {
+    const __m256i m = _mm256_set1_epi64x(~0ull / ((1ull << j) + 1));
+    const size_t q = j / 4;
+#pragma GCC unroll 16
+    for (size_t k = 0; k < n; k++) {
+        if (k & q)
+            continue;
+        if (j == 32) {
+            __m256i a = v[k], b = v[k + q];
+            v[k] = _mm256_blend_epi32(a, _mm256_slli_epi64(b, 32), 0xAA);
+            v[k + q] = _mm256_blend_epi32(_mm256_srli_epi64(a, 32), b, 0xAA);
+            continue;
+        }
+        if (j == 16) {
+            __m256i a = v[k], b = v[k + q];
+            v[k] = _mm256_blend_epi16(a, _mm256_slli_epi64(b, 16), 0xAA);
+            v[k + q] = _mm256_blend_epi16(_mm256_srli_epi64(a, 16), b, 0xAA);
+            continue;
+        }
+        __m256i t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(v[k], j), v[k + q]), m);
+        v[k + q] = _mm256_xor_si256(v[k + q], t);
+        v[k] = _mm256_xor_si256(v[k], _mm256_slli_epi64(t, j));
+    }
+}
+
+// Transpose depth rows held in depth / 4 vectors, depth = 4..64
+// Passes 2 and 1 pair rows inside a vector, so they swap lanes instead
+static inline __attribute__((always_inline)) void interleave_avx2(__m256i* v, const size_t depth) {
+    const size_t n = depth / 4;
+    if (depth > 32)
+        interleave_pass_avx2(v, n, 32);
+    if (depth > 16)
+        interleave_pass_avx2(v, n, 16);
+    if (depth > 8)
+        interleave_pass_avx2(v, n, 8);
+    if (depth > 4)
+        interleave_pass_avx2(v, n, 4);
+    const __m256i m2 = _mm256_set_epi64x(0, 0, 0x3333333333333333, 0x3333333333333333);
+    const __m256i m1 = _mm256_set_epi64x(0, 0x5555555555555555, 0, 0x5555555555555555);
+#pragma GCC unroll 16
+    for (size_t k = 0; k < n; k++) {
+        __m256i s = _mm256_permute4x64_epi64(v[k], _MM_SHUFFLE(1, 0, 3, 2));
+        __m256i t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(v[k], 2), s), m2);
+        v[k] = _mm256_xor_si256(v[k], _mm256_xor_si256(_mm256_slli_epi64(t, 2),
+            _mm256_permute4x64_epi64(t, _MM_SHUFFLE(1, 0, 3, 2))));
+        s = _mm256_shuffle_epi32(v[k], _MM_SHUFFLE(1, 0, 3, 2));
+        t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(v[k], 1), s), m1);
+        v[k] = _mm256_xor_si256(v[k], _mm256_xor_si256(_mm256_slli_epi64(t, 1),
+            _mm256_shuffle_epi32(t, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+}
+#endif
+
+// Transpose D blocks in place, log2(D) swap passes over D words
+// Depth must be a compile time constant for the passes to unroll
+static inline __attribute__((always_inline)) void interleave(uint64_t* blocks, const size_t depth) {
+#ifdef __AVX2__
+    if (depth >= 4) {
+        __m256i v[16];
+        for (size_t k = 0; k < depth / 4; k++)
+            v[k] = _mm256_loadu_si256((const __m256i*)(blocks + 4 * k));
+        interleave_avx2(v, depth);
+        for (size_t k = 0; k < depth / 4; k++)
+            _mm256_storeu_si256((__m256i*)(blocks + 4 * k), v[k]);
+        return;
+    }
+#endif
+    for (size_t j = depth >> 1; j; j >>= 1) {
+        uint64_t m = ~0ull / ((1ull << j) + 1); // Low j bits of every 2j bits
+        for (size_t k = 0; k < depth; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((blocks[k] >> j) ^ blocks[k | j]) & m;
+            blocks[k | j] ^= t;
+            blocks[k] ^= t << j;
+        }
+    }
+}
+
+// Encode and interleave one group, each block is read and written once
+static inline __attribute__((always_inline)) void encode_interleave_group(uint64_t* blocks, const size_t depth) {
+#ifdef __AVX2__
+    if (depth >= 4) {
+        __m256i v[16];
+        for (size_t k = 0; k < depth / 4; k++)
+            v[k] = _mm256_set_epi64x(encode(blocks[4 * k + 3]), encode(blocks[4 * k + 2]),
+                                     encode(blocks[4 * k + 1]), encode(blocks[4 * k]));
+        interleave_avx2(v, depth);
+        for (size_t k = 0; k < depth / 4; k++)
+            _mm256_storeu_si256((__m256i*)(blocks + 4 * k), v[k]);
+        return;
+    }
+#endif
+    encode_batch(blocks, depth);
+    interleave(blocks, depth);
+}
+
+// Deinterleave and decode one group, return number of uncorrectable blocks
+// Blocks are decoded straight out of the transposed vectors, reloading them
+// right after a 32 byte store would stall on store forwarding
+static inline __attribute__((always_inline)) size_t decode_interleave_group(uint64_t* blocks, const size_t depth) {
+#ifdef __AVX2__
+    if (depth >= 4) {
+        __m256i v[16];
+        size_t failed = 0;
+        for (size_t k = 0; k < depth / 4; k++)
+            v[k] = _mm256_loadu_si256((const __m256i*)(blocks + 4 * k));
+        interleave_avx2(v, depth);
+        for (size_t k = 0; k < depth / 4; k++) {
+            __m128i lo = _mm256_castsi256_si128(v[k]), hi = _mm256_extracti128_si256(v[k], 1);
+            uint64_t x[4] = {
+                (uint64_t)_mm_cvtsi128_si64(lo), (uint64_t)_mm_extract_epi64(lo, 1),
+                (uint64_t)_mm_cvtsi128_si64(hi), (uint64_t)_mm_extract_epi64(hi, 1),
+            };
+            for (size_t l = 0; l < 4; l++) {
+                failed += !decode(&x[l]);
+                blocks[4 * k + l] = x[l];
+            }
+        }
+        return failed;
+    }
+#endif
+    interleave(blocks, depth);
+    return decode_batch(blocks, depth);
+}
+
+// Supported group depth for a requested depth: a power of two in 1..64,
+// rounded down, so encode and decode always agree on the group layout
+static inline size_t interleave_valid_depth(size_t depth) {
+    if (depth == 0)
+        return 1;
+    if (depth > 64)
+        return 64;
+    while (depth & (depth - 1))
+        depth &= depth - 1;
+    return depth;
+}
+
+// Blocks covered by full groups, the rest is interleaved with stride
+static inline size_t interleave_full_blocks(size_t count, size_t depth) {
+    if (count < depth)
+        return 0;
+    return count % depth ? count - depth - count % depth : count;
+}
+
+// Or bits low bits of v into the bit stream at pos, bits = 1..64
+static inline void interleave_put(uint64_t* stream, size_t pos, uint64_t v, size_t bits) {
+    stream[pos / 64] |= v << (pos % 64);
+    if (pos % 64 + bits > 64)
+        stream[pos / 64 + 1] |= v >> (64 - pos % 64);
+}
+
+// Read bits bits of the bit stream at pos, bits = 1..64
+static inline uint64_t interleave_get(const uint64_t* stream, size_t pos, size_t bits) {
+    uint64_t v = stream[pos / 64] >> (pos % 64);
+    if (pos % 64 + bits > 64)
+        v |= stream[pos / 64 + 1] << (64 - pos % 64);
+    return bits == 64 ? v : v & ((1ull << bits) - 1);
+}
+
+// Interleave n < 128 blocks with stride n, or undo it
+// Bit c of blocks 0..63 and 64..n-1 is gathered by two 64 x 64 transposes,
+// then each column is one run of n stream bits.
+static inline void interleave_stride(uint64_t* blocks, size_t n, bool inverse) {
+    uint64_t lo[64] = {0}, hi[64] = {0};
+    size_t n_lo = n < 64 ? n : 64, n_hi = n - n_lo;
+    if (!inverse) {
+        memcpy(lo, blocks, n_lo * sizeof(uint64_t));
+        memcpy(hi, blocks + n_lo, n_hi * sizeof(uint64_t));
+        interleave(lo, 64);
+        if (n_hi)
+            interleave(hi, 64);
+        memset(blocks, 0, n * sizeof(uint64_t));
+        for (size_t c = 0; c < 64; c++) {
+            interleave_put(blocks, c * n, lo[c], n_lo);
+            if (n_hi)
+                interleave_put(blocks, c * n + 64, hi[c], n_hi);
+        }
+    } else {
+        for (size_t c = 0; c < 64; c++) {
+            lo[c] = interleave_get(blocks, c * n, n_lo);
+            if (n_hi)
+                hi[c] = interleave_get(blocks, c * n + 64, n_hi);
+        }
+        interleave(lo, 64);
+        if (n_hi)
+            interleave(hi, 64);
+        memcpy(blocks, lo, n_lo * sizeof(uint64_t));
+        memcpy(blocks + n_lo, hi, n_hi * sizeof(uint64_t));
+    }
+}
+
+// Encode and interleave full groups of constant depth
+static inline __attribute__((always_inline)) void encode_interleaved_groups(uint64_t* data, size_t count, const size_t depth) {
+    for (size_t i = 0; i < count; i += depth)
+        encode_interleave_group(data + i, depth);
+}
+
+// Deinterleave and decode full groups of constant depth, return number of uncorrectable blocks
+static inline __attribute__((always_inline)) size_t decode_interleaved_groups(uint64_t* data, size_t count, const size_t depth) {
+    size_t failed = 0;
+    for (size_t i = 0; i < count; i += depth)
+        failed += decode_interleave_group(data + i, depth);
+    return failed;
+}
+
+// Encode and interleave blocks in place
+// Depth is rounded down to a power of two in 1..64
+static inline void encode_interleaved(uint64_t* data, size_t count, size_t depth) {
+    depth = interleave_valid_depth(depth);
+    size_t full = interleave_full_blocks(count, depth);
+    // Constant depths let the transpose unroll
+    switch (depth) {
+        case 64: encode_interleaved_groups(data, full, 64); break;
+        case 32: encode_interleaved_groups(data, full, 32); break;
+        case 16: encode_interleaved_groups(data, full, 16); break;
+        case 8:  encode_interleaved_groups(data, full, 8);  break;
+        case 4:  encode_interleaved_groups(data, full, 4);  break;
+        case 2:  encode_interleaved_groups(data, full, 2);  break;
+        default: encode_batch(data, full); break;
+    }
+    if (full < count) {
+        encode_batch(data + full, count - full);
+        interleave_stride(data + full, count - full, false);
+    }
+}
+
+// Deinterleave and decode blocks in place, return number of uncorrectable blocks
+// Depth is rounded down as in encode_interleaved
+static inline size_t decode_interleaved(uint64_t* data, size_t count, size_t depth) {
+    size_t failed = 0;
+    depth = interleave_valid_depth(depth);
+    size_t full = interleave_full_blocks(count, depth);
+    if (full < count) {
+        interleave_stride(data + full, count - full, true);
+        failed += decode_batch(data + full, count - full);
+    }
+    switch (depth) {
+        case 64: failed += decode_interleaved_groups(data, full, 64); break;
+        case 32: failed += decode_interleaved_groups(data, full, 32); break;
+        case 16: failed += decode_interleaved_groups(data, full, 16); break;
+        case 8:  failed += decode_interleaved_groups(data, full, 8);  break;
+        case 4:  failed += decode_interleaved_groups(data, full, 4);  break;
+        case 2:  failed += decode_interleaved_groups(data, full, 2);  break;
+        default: failed += decode_batch(data, full); break;
+    }
+    return failed;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hamming.h"
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/*
+    Generated (2^r, 2^r - r - 1) Hamming-Codes
+    Parity bits on 0 (extend bit) and 1, 2, 4, ..., 2^(r-1)
+    Data bits fill the remaining positions in order
+
+    HAMMING_CODE(name, type, r) generates name##_encode / name##_decode etc.
+    All masks are constant expressions of (type, r), so loops below are fully
+    unrolled and folded by the compiler.
+*/
+
+typedef unsigned __int128 uint128_t;
+
+#ifdef __BMI2__
+#define HAMMING_PDEP 1
+#else
+#define HAMMING_PDEP 0
+#endif
+
+// Software fallbacks are never called when HAMMING_PDEP is 0,
+// they only keep the generated code compilable.
+static inline uint64_t pdep64(uint64_t x, uint64_t mask) {
+#ifdef __BMI2__
+    return _pdep_u64(x, mask);
+#else
+    uint64_t r = 0;
+    for (uint64_t bit = 1; mask; bit <<= 1, mask &= mask - 1)
+        if (x & bit)
+            r |= mask & -mask;
+    return r;
+#endif
+}
+
+static inline uint64_t pext64(uint64_t x, uint64_t mask) {
+#ifdef __BMI2__
+    return _pext_u64(x, mask);
+#else
+    uint64_t r = 0;
+    for (uint64_t bit = 1; mask; bit <<= 1, mask &= mask - 1)
+        if (x & mask & -mask)
+            r |= bit;
+    return r;
+#endif
+}
+
+static inline uint64_t popcnt128(uint128_t x) {
+    return popcnt64((uint64_t)x) + popcnt64((uint64_t)(x >> 64));
+}
+
+// Deposit across two halves, low half consumes popcnt(low mask) bits
+static inline uint128_t pdep128(uint128_t x, uint128_t mask) {
+    uint64_t lo_mask = (uint64_t)mask;
+    uint64_t lo = pdep64((uint64_t)x, lo_mask);
+    uint64_t hi = pdep64((uint64_t)(x >> popcnt64(lo_mask)), (uint64_t)(mask >> 64));
+    return (uint128_t)hi << 64 | lo;
+}
+
+static inline uint128_t pext128(uint128_t x, uint128_t mask) {
+    uint64_t lo_mask = (uint64_t)mask;
+    uint64_t lo = pext64((uint64_t)x, lo_mask);
+    uint64_t hi = pext64((uint64_t)(x >> 64), (uint64_t)(mask >> 64));
+    return (uint128_t)hi << popcnt64(lo_mask) | lo;
+}
+
+// Bits whose position has bit j set: 0xAA.., 0xCC.., 0xF0.., ...
+#define HAMMING_MASK(type, j) \
+    ((type)((type)~(type)0 / (((type)1 << (1u << (j))) + 1) << (1u << (j))))
+
+// Data bits of segment i (positions 2^i + 1 .. 2^(i+1) - 1) before repositioning
+#define HAMMING_SEGMENT(type, i) \
+    ((type)((((type)1 << ((1u << (i)) - 1)) - 1) << ((1u << (i)) - (i) - 1)))
+
+#define HAMMING_CODE(name, type, r, popcnt, pdep, pext)                         \
+                                                                                \
+enum { name##_block_bits = 1 << (r), name##_data_bits = (1 << (r)) - (r) - 1 }; \
+                                                                                \
+static inline type name##_data_mask(void) {                                     \
+    type m = (type)~(type)1;                                                    \
+    _Pragma("GCC unroll 8")                                                     \
+    for (unsigned j = 0; j < (r); j++)                                          \
+        m &= (type)~((type)1 << (1u << j));                                     \
+    return m;                                                                   \
+}                                                                               \
+                                                                                \
+static inline type name##_reposition(type x) {                                  \
+    if (HAMMING_PDEP)                                                           \
+        return (type)pdep(x, name##_data_mask());                               \
+    type result = 0;                                                            \
+    _Pragma("GCC unroll 8")                                                     \
+    for (unsigned i = 1; i < (r); i++)                                          \
+        result |= (type)((x & HAMMING_SEGMENT(type, i)) << (i + 2));            \
+    return result;                                                              \
+}                                                                               \
+                                                                                \
+static inline type name##_unreposition(type x) {                                \
+    if (HAMMING_PDEP)                                                           \
+        return (type)pext(x, name##_data_mask());                               \
+    type result = 0;                                                            \
+    _Pragma("GCC unroll 8")                                                     \
+    for (unsigned i = 1; i < (r); i++)                                          \
+        result |= (type)((x >> (i + 2)) & HAMMING_SEGMENT(type, i));            \
+    return result;                                                              \
+}                                                                               \
+                                                                                \
+static inline type name##_set_parity(type x) {                                  \
+    _Pragma("GCC unroll 8")                                                     \
+    for (unsigned j = 0; j < (r); j++)                                          \
+        x ^= (type)((type)(popcnt(x & HAMMING_MASK(type, j)) & 1) << (1u << j)); \
+    x ^= (type)(popcnt(x) & 1);                                                 \
+    return x;                                                                   \
+}                                                                               \
+                                                                                \
+static inline uint64_t name##_find_error_position(type x) {                     \
+    uint64_t position = 0;                                                      \
+    _Pragma("GCC unroll 8")                                                     \
+    for (unsigned j = 0; j < (r); j++)                                          \
+        position |= (popcnt(x & HAMMING_MASK(type, j)) & 1) << j;               \
+    return position;                                                            \
+}                                                                               \
+                                                                                \
+static inline bool name##_correct_block(type* x) {                              \
+    uint64_t ep = name##_find_error_position(*x);                               \
+    if (popcnt(*x) & 1) {                                                       \
+        *x ^= (type)1 << ep;                                                    \
+        return true;                                                            \
+    } else if (!ep) {                                                           \
+        return true;                                                            \
+    } else {                                                                    \
+        return false;                                                           \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+static inline type name##_encode(type x) {                                      \
+    return name##_set_parity(name##_reposition(x));                             \
+}                                                                               \
+                                                                                \
+static inline bool name##_decode(type* x) {                                     \
+    if (name##_correct_block(x)) {                                              \
+        *x = name##_unreposition(*x);                                           \
+        return true;                                                            \
+    } else {                                                                    \
+        return false;                                                           \
+    }                                                                           \
+}
+
+HAMMING_CODE(h8_4,     uint8_t,   3, popcnt64,  pdep64,  pext64)
+HAMMING_CODE(h16_11,   uint16_t,  4, popcnt64,  pdep64,  pext64)
+HAMMING_CODE(h32_26,   uint32_t,  5, popcnt64,  pdep64,  pext64)
+HAMMING_CODE(h64_57,   uint64_t,  6, popcnt64,  pdep64,  pext64)
+HAMMING_CODE(h128_120, uint128_t, 7, popcnt128, pdep128, pext128)
@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+#include "st7789_sim.h"
+// Pin and panel configuration
+#include "st7789.h"
+
+/*  =============================
+ *      Recording
+ *  ============================= */
+
+GPIO_TypeDef sim_gpio_ports[3];
+
+static st7789_sim_stats_t stats;
+static uint32_t spi_hz = ST7789_SIM_SPI_HZ;
+static double now, idle;
+
+static struct {
+    bool active;
+    SPI_HandleTypeDef* hspi;
+    const uint8_t* data;
+    uint16_t size;
+    double end;
+} dma;
+static int64_t dma_fail_after = -1;    // Successful DMA starts left before one fails, -1 never
+
+static st7789_sim_event_t* events;
+static size_t event_count, event_capacity;
+static uint8_t* bytes;
+static size_t byte_count, byte_capacity;
+
+static void record_event(st7789_sim_event_type_t type, uint32_t value, uint32_t offset, uint8_t dc) {
+    if (event_count == event_capacity) {
+        event_capacity = event_capacity ? event_capacity * 2 : 1024;
+        events = realloc(events, event_capacity * sizeof(st7789_sim_event_t));
+    }
+    events[event_count++] = (st7789_sim_event_t) {
+        .type = type,
+        .value = value,
+        .offset = offset,
+        .dc = dc,
+    };
+}
+
+static void record_bytes(const uint8_t* data, size_t size) {
+    if (byte_count + size > byte_capacity) {
+        while (byte_count + size > byte_capacity)
+            byte_capacity = byte_capacity ? byte_capacity * 2 : 65536;
+        bytes = realloc(bytes, byte_capacity);
+    }
+    memcpy(bytes + byte_count, data, size);
+    byte_count += size;
+}
+
+/*  =============================
+ *      Controller
+ *  ============================= */
+
+static uint32_t gram[ST7789_SIM_GRAM_WIDTH * ST7789_SIM_GRAM_HEIGHT];
+
+static struct {
+    bool cs, dc, reset;         // Pin levels, CS and reset are low active
+    uint8_t command;
+    uint32_t param_index;
+    uint8_t params[4];
+    uint16_t xs, xe, ys, ye;    // Window from CASET / RASET
+    uint16_t col, row;          // RAMWR cursor
+    uint8_t pixel[3];
+    uint8_t pixel_len;
+    uint8_t madctl, colmod;
+    bool sleeping, display_on, inverted;
+} ctl;
+
+static void controller_reset(void) {
+    ctl.command = 0;
+    ctl.param_index = 0;
+    ctl.xs = 0;
+    ctl.xe = ST7789_SIM_GRAM_WIDTH - 1;
+    ctl.ys = 0;
+    ctl.ye = ST7789_SIM_GRAM_HEIGHT - 1;
+    ctl.pixel_len = 0;
+    ctl.madctl = 0;
+    ctl.colmod = 0x66;
+    ctl.sleeping = true;
+    ctl.display_on = false;
+    ctl.inverted = false;
+}
+
+static inline uint32_t expand6(uint32_t v) {
+    return (v << 2 | v >> 4) & 0xff;
+}
+
+static inline uint32_t rgb666(uint32_t r, uint32_t g, uint32_t b) {
+    return expand6(r) << 16 | expand6(g) << 8 | expand6(b);
+}
+
+// Store at the cursor and advance, logical address mapped through MADCTL
+static void write_pixel(uint32_t color) {
+    bool my = ctl.madctl >> 7 & 1, mx = ctl.madctl >> 6 & 1, mv = ctl.madctl >> 5 & 1;
+    uint32_t px = mv ? ctl.row : ctl.col;
+    uint32_t py = mv ? ctl.col : ctl.row;
+    if (px < ST7789_SIM_GRAM_WIDTH && py < ST7789_SIM_GRAM_HEIGHT) {
+        if (mx)
+            px = ST7789_SIM_GRAM_WIDTH - 1 - px;
+        if (my)
+            py = ST7789_SIM_GRAM_HEIGHT - 1 - py;
+        gram[py * ST7789_SIM_GRAM_WIDTH + px] = color;
+        stats.pixels++;
+    }
+    if (ctl.col++ == ctl.xe) {
+        ctl.col = ctl.xs;
+        if (ctl.row++ == ctl.ye)
+            ctl.row = ctl.ys;
+    }
+}
+
+static void pixel_byte(uint8_t byte) {
+    ctl.pixel[ctl.pixel_len++] = byte;
+    switch (ctl.colmod & 0x07) {
+        case 0x03: // 12 bit, 2 pixels in 3 bytes: RG BR GB, each written once complete
+            if (ctl.pixel_len == 2) {
+                write_pixel(rgb666((ctl.pixel[0] >> 4) << 2, (ctl.pixel[0] & 0x0f) << 2, (ctl.pixel[1] >> 4) << 2));
+            } else if (ctl.pixel_len == 3) {
+                write_pixel(rgb666((ctl.pixel[1] & 0x0f) << 2, (ctl.pixel[2] >> 4) << 2, (ctl.pixel[2] & 0x0f) << 2));
+                ctl.pixel_len = 0;
+            }
+            break;
+        case 0x05: // 16 bit, RGB565 big endian
+            if (ctl.pixel_len == 2) {
+                uint32_t v = ctl.pixel[0] << 8 | ctl.pixel[1];
+                write_pixel(rgb666((v >> 11) << 1, v >> 5 & 0x3f, (v & 0x1f) << 1));
+                ctl.pixel_len = 0;
+            }
+            break;
+        default: // 18 bit, upper 6 bits of each byte
+            if (ctl.pixel_len == 3) {
+                write_pixel(rgb666(ctl.pixel[0] >> 2, ctl.pixel[1] >> 2, ctl.pixel[2] >> 2));
+                ctl.pixel_len = 0;
+            }
+            break;
+    }
+}
+
+static void controller_command(uint8_t command) {
+    ctl.command = command;
+    ctl.param_index = 0;
+    ctl.pixel_len = 0;
+    switch (command) {
+        case 0x01: controller_reset(); break;           // Software Reset
+        case 0x10: ctl.sleeping = true; break;          // Sleep In
+        case 0x11: ctl.sleeping = false; break;         // Sleep Out
+        case 0x20: ctl.inverted = false; break;         // Inversion Off
+        case 0x21: ctl.inverted = true; break;          // Inversion On
+        case 0x28: ctl.display_on = false; break;       // Display Off
+        case 0x29: ctl.display_on = true; break;        // Display On
+        case 0x2C:                                      // Memory Write
+            ctl.col = ctl.xs;
+            ctl.row = ctl.ys;
+            break;
+        default: break;
+    }
+}
+
+static void controller_data(uint8_t byte) {
+    uint32_t index = ctl.param_index++;
+    if (index < sizeof(ctl.params))
+        ctl.params[index] = byte;
+    switch (ctl.command) {
+        case 0x2A: // Column Address Set
+            if (index == 3) {
+                ctl.xs = ctl.params[0] << 8 | ctl.params[1];
+                ctl.xe = ctl.params[2] << 8 | ctl.params[3];
+            }
+            break;
+        case 0x2B: // Row Address Set
+            if (index == 3) {
+                ctl.ys = ctl.params[0] << 8 | ctl.params[1];
+                ctl.ye = ctl.params[2] << 8 | ctl.params[3];
+            }
+            break;
+        case 0x2C: // Memory Write
+            pixel_byte(byte);
+            break;
+        case 0x36: // Memory Data Access Control
+            if (index == 0)
+                ctl.madctl = byte;
+            break;
+        case 0x3A: // Interface Pixel Format
+            if (index == 0)
+                ctl.colmod = byte;
+            break;
+        default: break;
+    }
+}
+
+static void controller_bytes(const uint8_t* data, uint16_t size) {
+    // Controller ignores the bus while deselected or held in reset
+    if (!ctl.cs || ctl.reset)
+        return;
+    for (uint16_t i = 0; i < size; i++) {
+        if (!ctl.dc) {
+            stats.commands++;
+            controller_command(data[i]);
+        } else {
+            controller_data(data[i]);
+        }
+    }
+}
+
+/*  =============================
+ *      Time and DMA
+ *  ============================= */
+
+static inline double wire_seconds(uint32_t size) {
+    return size * 8.0 / spi_hz;
+}
+
+// The controller sees DMA bytes at completion, with the pins as they are then,
+// so a driver touching D/C or the buffer early shows up in GRAM.
+static void complete_dma(void) {
+    now = dma.end;
+    dma.active = false;
+    controller_bytes(dma.data, dma.size);
+    HAL_SPI_TxCpltCallback(dma.hspi);
+}
+
+static void advance(double seconds, bool sleeping) {
+    double target = now + seconds;
+    while (dma.active && dma.end <= target)
+        complete_dma();
+    now = target;
+    if (sleeping)
+        idle += seconds;
+}
+
+/*  =============================
+ *      HAL stand-in
+ *  ============================= */
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    if (PinState)
+        GPIOx->ODR |= GPIO_Pin;
+    else
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+
+    bool level = PinState != GPIO_PIN_RESET;
+    if (GPIOx == ST7789_CS_GPIO && GPIO_Pin == ST7789_CS_PIN) {
+        bool selected = !level;
+        if (selected != ctl.cs) {
+            stats.cs_toggles++;
+            stats.cs_frames += selected;
+            record_event(ST7789_SIM_EVENT_CS, level, 0, 0);
+        }
+        ctl.cs = selected;
+    } else if (GPIOx == ST7789_DC_GPIO && GPIO_Pin == ST7789_DC_PIN) {
+        if (level != ctl.dc) {
+            stats.dc_toggles++;
+            record_event(ST7789_SIM_EVENT_DC, level, 0, 0);
+        }
+        ctl.dc = level;
+    } else if (GPIOx == ST7789_RESET_GPIO && GPIO_Pin == ST7789_RESET_PIN) {
+        bool reset = !level;
+        if (reset != ctl.reset)
+            record_event(ST7789_SIM_EVENT_RESET, level, 0, 0);
+        if (reset && !ctl.reset)
+            controller_reset();
+        ctl.reset = reset;
+    }
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef* hspi, const uint8_t* pData, uint16_t Size, uint32_t Timeout) {
+    (void)hspi;
+    (void)Timeout;
+    if (dma.active) {
+        stats.busy_errors++;
+        return HAL_BUSY;
+    }
+    record_event(ST7789_SIM_EVENT_SPI, Size, byte_count, ctl.dc);
+    record_bytes(pData, Size);
+    stats.transactions++;
+    stats.bytes += Size;
+    controller_bytes(pData, Size);
+    advance(wire_seconds(Size), false);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef* hspi, const uint8_t* pData, uint16_t Size) {
+    if (dma.active) {
+        stats.busy_errors++;
+        return HAL_BUSY;
+    }
+    if (!Size)
+        return HAL_ERROR;
+    if (dma_fail_after == 0) {
+        dma_fail_after = -1;
+        return HAL_ERROR;
+    }
+    if (dma_fail_after > 0)
+        dma_fail_after--;
+    record_event(ST7789_SIM_EVENT_SPI_DMA, Size, byte_count, ctl.dc);
+    record_bytes(pData, Size);
+    stats.transactions++;
+    stats.dma_transactions++;
+    stats.bytes += Size;
+    dma.active = true;
+    dma.hspi = hspi;
+    dma.data = pData;
+    dma.size = Size;
+    dma.end = now + wire_seconds(Size);
+    return HAL_OK;
+}
+
+__attribute__((weak)) void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi) {
+    (void)hspi;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    record_event(ST7789_SIM_EVENT_DELAY, Delay, 0, 0);
+    stats.delay_ms += Delay;
+    advance(Delay / 1000.0, false);
+}
+
+uint32_t HAL_GetTick(void) {
+    return (uint32_t)(now * 1000.0);
+}
+
+void __WFI(void) {
+    // Nothing would ever wake the CPU up
+    if (!dma.active) {
+        fprintf(stderr, "st7789_sim: __WFI with no DMA transfer in flight\n");
+        abort();
+    }
+    advance(dma.end - now, true);
+}
+
+void __disable_irq(void) {
+}
+
+void __enable_irq(void) {
+}
+
+/*  =============================
+ *      Simulator interface
+ *  ============================= */
+
+void st7789_sim_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+    event_count = 0;
+    byte_count = 0;
+}
+
+void st7789_sim_reset(void) {
+    st7789_sim_reset_stats();
+    memset(sim_gpio_ports, 0, sizeof(sim_gpio_ports));
+    memset(&ctl, 0, sizeof(ctl));
+    memset(&dma, 0, sizeof(dma));
+    dma_fail_after = -1;
+    controller_reset();
+    now = 0;
+    idle = 0;
+}
+
+void st7789_sim_set_spi_hz(uint32_t hz) {
+    spi_hz = hz;
+}
+
+uint32_t st7789_sim_spi_hz(void) {
+    return spi_hz;
+}
+
+void st7789_sim_fail_dma(uint32_t after) {
+    dma_fail_after = after;
+}
+
+double st7789_sim_time(void) {
+    return now;
+}
+
+double st7789_sim_idle_time(void) {
+    return idle;
+}
+
+void st7789_sim_cpu(double seconds) {
+    advance(seconds, false);
+}
+
+st7789_sim_stats_t st7789_sim_stats(void) {
+    return stats;
+}
+
+double st7789_sim_wire_time(st7789_sim_stats_t s, uint32_t spi_hz, double transaction_overhead) {
+    return s.bytes * 8.0 / spi_hz + s.transactions * transaction_overhead;
+}
+
+void st7789_sim_print_stats(FILE* file, const char* label, st7789_sim_stats_t s) {
+    fprintf(file, "%-24s %8llu bytes %6llu transactions %6llu frames %6llu dc toggles %8llu pixels, "
+        "%9.3lf ms at %g MHz\n",
+        label, (unsigned long long)s.bytes, (unsigned long long)s.transactions,
+        (unsigned long long)s.cs_frames, (unsigned long long)s.dc_toggles, (unsigned long long)s.pixels,
+        1000.0 * st7789_sim_wire_time(s, spi_hz, 0), spi_hz / 1e6);
+}
+
+const st7789_sim_event_t* st7789_sim_events(size_t* count) {
+    *count = event_count;
+    return events;
+}
+
+const uint8_t* st7789_sim_bytes(size_t* count) {
+    *count = byte_count;
+    return bytes;
+}
+
+void st7789_sim_print_log(FILE* file, size_t max_events) {
+    for (size_t i = 0; i < event_count && i < max_events; i++) {
+        const st7789_sim_event_t* e = &events[i];
+        switch (e->type) {
+            case ST7789_SIM_EVENT_SPI:
+            case ST7789_SIM_EVENT_SPI_DMA:
+                fprintf(file, "%s %s %5u:", e->type == ST7789_SIM_EVENT_SPI ? "SPI  " : "DMA  ",
+                    e->dc ? "data" : "cmd ", e->value);
+                for (uint32_t j = 0; j < e->value && j < 16; j++)
+                    fprintf(file, " %02X", bytes[e->offset + j]);
+                fprintf(file, e->value > 16 ? " ...\n" : "\n");
+                break;
+            case ST7789_SIM_EVENT_CS:    fprintf(file, "CS    %u\n", e->value); break;
+            case ST7789_SIM_EVENT_DC:    fprintf(file, "DC    %u\n", e->value); break;
+            case ST7789_SIM_EVENT_RESET: fprintf(file, "RESET %u\n", e->value); break;
+            case ST7789_SIM_EVENT_DELAY: fprintf(file, "DELAY %u ms\n", e->value); break;
+        }
+    }
+}
+
+uint32_t st7789_sim_pixel(uint16_t x, uint16_t y) {
+    return gram[y * ST7789_SIM_GRAM_WIDTH + x];
+}
+
+const uint32_t* st7789_sim_gram(void) {
+    return gram;
+}
+
+void st7789_sim_clear_gram(uint32_t color) {
+    for (size_t i = 0; i < ST7789_SIM_GRAM_WIDTH * ST7789_SIM_GRAM_HEIGHT; i++)
+        gram[i] = color;
+}
+
+bool st7789_sim_dump_ppm(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", ST7789_SIM_GRAM_WIDTH, ST7789_SIM_GRAM_HEIGHT);
+    for (size_t i = 0; i < ST7789_SIM_GRAM_WIDTH * ST7789_SIM_GRAM_HEIGHT; i++) {
+        uint8_t rgb[3] = {gram[i] >> 16, gram[i] >> 8, gram[i]};
+        fwrite(rgb, 1, 3, file);
+    }
+    fclose(file);
+    return true;
+}
+
+uint8_t st7789_sim_madctl(void) { return ctl.madctl; }
+uint8_t st7789_sim_colmod(void) { return ctl.colmod; }
+bool st7789_sim_sleeping(void) { return ctl.sleeping; }
+bool st7789_sim_display_on(void) { return ctl.display_on; }
+bool st7789_sim_inverted(void) { return ctl.inverted; }
@@ -0,0 +1,95 @@
+#pragma once
+
+/*  =============================
+ *      Host ST7789 simulator
+ *  =============================
+ *  The stand-in HAL feeds every SPI byte and GPIO write to a simulated
+ *  ST7789. The controller decodes the command stream into its 240x320
+ *  GRAM, and the bus side counts bytes, transactions and pin toggles.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Controller GRAM, in physical (unrotated) orientation */
+#define ST7789_SIM_GRAM_WIDTH (240)
+#define ST7789_SIM_GRAM_HEIGHT (320)
+
+/* Default SPI clock for wire time estimates */
+#define ST7789_SIM_SPI_HZ (42000000)
+
+typedef enum {
+    ST7789_SIM_EVENT_SPI,       // One HAL_SPI_Transmit call
+    ST7789_SIM_EVENT_SPI_DMA,   // One HAL_SPI_Transmit_DMA call
+    ST7789_SIM_EVENT_CS,        // CS level change
+    ST7789_SIM_EVENT_DC,        // D/C level change
+    ST7789_SIM_EVENT_RESET,     // Reset level change
+    ST7789_SIM_EVENT_DELAY,     // HAL_Delay
+} st7789_sim_event_type_t;
+
+typedef struct {
+    st7789_sim_event_type_t type;
+    uint32_t value;             // Level for pins, bytes for SPI, ms for delays
+    uint32_t offset;            // First byte in the byte log for SPI
+    uint8_t dc;                 // D/C level during SPI
+} st7789_sim_event_t;
+
+typedef struct {
+    uint64_t bytes;             // Bytes clocked out on SPI
+    uint64_t transactions;      // HAL SPI transmit calls, blocking and DMA
+    uint64_t dma_transactions;  // HAL SPI transmit DMA calls
+    uint64_t busy_errors;       // Transmits attempted while a DMA transfer was in flight
+    uint64_t cs_frames;         // CS assertions (falling edges)
+    uint64_t cs_toggles;
+    uint64_t dc_toggles;
+    uint64_t commands;          // Bytes sent with D/C low
+    uint64_t pixels;            // Pixels written to GRAM
+    uint64_t delay_ms;          // Total HAL_Delay time
+} st7789_sim_stats_t;
+
+/// Reset bus counters, event log and controller state (GRAM is kept)
+void st7789_sim_reset(void);
+/// Reset bus counters and event log only
+void st7789_sim_reset_stats(void);
+
+st7789_sim_stats_t st7789_sim_stats(void);
+/// Estimated wire time in seconds: bits at spi_hz plus a fixed cost per transaction
+double st7789_sim_wire_time(st7789_sim_stats_t stats, uint32_t spi_hz, double transaction_overhead);
+void st7789_sim_print_stats(FILE* file, const char* label, st7789_sim_stats_t stats);
+
+/*
+    Simulated time
+    Blocking transmits and delays keep the CPU busy for their duration.
+    DMA transfers take their wire time at the SPI clock and complete during
+    __WFI (counted as idle) or st7789_sim_cpu (application work).
+*/
+void st7789_sim_set_spi_hz(uint32_t spi_hz);
+/// SPI clock of the simulated timeline, also used by st7789_sim_print_stats
+uint32_t st7789_sim_spi_hz(void);
+/// Make HAL_SPI_Transmit_DMA return HAL_ERROR once, after the next `after` successful starts
+void st7789_sim_fail_dma(uint32_t after);
+/// Seconds since the last st7789_sim_reset
+double st7789_sim_time(void);
+/// Seconds spent in __WFI since the last st7789_sim_reset
+double st7789_sim_idle_time(void);
+/// Model application work taking the CPU for a number of seconds
+void st7789_sim_cpu(double seconds);
+
+/// Recorded events and bytes since the last reset
+const st7789_sim_event_t* st7789_sim_events(size_t* count);
+const uint8_t* st7789_sim_bytes(size_t* count);
+void st7789_sim_print_log(FILE* file, size_t max_events);
+
+/// GRAM pixel as 0x00RRGGBB, 6 bits per channel expanded to 8
+uint32_t st7789_sim_pixel(uint16_t x, uint16_t y);
+const uint32_t* st7789_sim_gram(void);
+void st7789_sim_clear_gram(uint32_t color);
+bool st7789_sim_dump_ppm(const char* path);
+
+/// Controller registers as last written
+uint8_t st7789_sim_madctl(void);
+uint8_t st7789_sim_colmod(void);
+bool st7789_sim_sleeping(void);
+bool st7789_sim_display_on(void);
+bool st7789_sim_inverted(void);
@@ -0,0 +1,727 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "st7789.h"
+#include "st7789_color.h"
+#include "st7789_gfx.h"
+#include "st7789_sim.h"
+#if ST7789_PIXEL_FORMAT != ST7789_PIXEL_FORMAT_12BIT
+#include "st7789_fb.h"
+#endif
+
+/*
+    ST7789 driver tests against the host simulator
+    Usage: test.o [output.ppm]
+*/
+
+SPI_HandleTypeDef hspi1;
+ST7789_DMA_HandleTypeDef hst7789;
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi) {
+    ST7789_DMA_TxCpltCallback(&hst7789, hspi);
+}
+
+#define SCREEN_WIDTH (ST7789_WIDTH)
+#define SCREEN_HEIGHT (ST7789_HEIGHT)
+
+// Application render cost model, about 4 cycles per pixel at 168 MHz
+#define RENDER_SECONDS_PER_PIXEL (25e-9)
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// GRAM value the simulator stores for an RGB888 color sent in the configured format
+static uint32_t gram_color(uint8_t r, uint8_t g, uint8_t b) {
+#if ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_12BIT
+    uint32_t r6 = (r >> 4) << 2, g6 = (g >> 4) << 2, b6 = (b >> 4) << 2;
+#elif ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_16BIT
+    uint32_t r6 = (r >> 3) << 1, g6 = g >> 2, b6 = (b >> 3) << 1;
+#else
+    uint32_t r6 = r >> 2, g6 = g >> 2, b6 = b >> 2;
+#endif
+    return (r6 << 2 | r6 >> 4) << 16 | (g6 << 2 | g6 >> 4) << 8 | (b6 << 2 | b6 >> 4);
+}
+
+// Wire bytes for n pixels of one color, returns byte count
+static size_t pack_color(uint8_t* buf, size_t n, uint8_t r, uint8_t g, uint8_t b) {
+    size_t len = 0;
+#if ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_12BIT
+    for (size_t i = 0; i < n; i += 2) {
+        buf[len++] = (r & 0xf0) | g >> 4;
+        buf[len++] = (b & 0xf0) | r >> 4;
+        buf[len++] = (g & 0xf0) | b >> 4;
+    }
+#elif ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_16BIT
+    uint16_t v = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+    for (size_t i = 0; i < n; i++) {
+        buf[len++] = v >> 8;
+        buf[len++] = v & 0xff;
+    }
+#else
+    for (size_t i = 0; i < n; i++) {
+        buf[len++] = r & 0xfc;
+        buf[len++] = g & 0xfc;
+        buf[len++] = b & 0xfc;
+    }
+#endif
+    return len;
+}
+
+// Reference fill: write area, then the pixels of each row
+static void fill_rows(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t r, uint8_t g, uint8_t b) {
+    static uint8_t row[ST7789_MEM_Y_SIZE * 3];
+#if ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_12BIT
+    // 2 pixels per 3 bytes, odd rows go out in pairs
+    uint16_t rows = w % 2 ? 2 : 1;
+#else
+    uint16_t rows = 1;
+#endif
+    size_t len = pack_color(row, w * rows, r, g, b);
+    ST7789_SetWriteArea(&hspi1, x, y, w, h);
+    for (uint16_t i = 0; i < h; i += rows)
+        ST7789_Transmit(&hspi1, row, len, ST7789_SPI_TIMEOUT);
+}
+
+static size_t count_color(uint32_t color) {
+    size_t n = 0;
+    const uint32_t* gram = st7789_sim_gram();
+    for (size_t i = 0; i < ST7789_SIM_GRAM_WIDTH * ST7789_SIM_GRAM_HEIGHT; i++)
+        n += gram[i] == color;
+    return n;
+}
+
+static void test_init(void) {
+    st7789_sim_reset();
+    ST7789_Reset(20, 150);
+    ST7789_Init(&hspi1);
+    ST7789_SetDisplay(&hspi1, true);
+    ST7789_SetBacklight(true);
+    st7789_sim_print_stats(stdout, "init", st7789_sim_stats());
+
+    CHECK(st7789_sim_madctl() == (ST7789_EXCHANGE_XY << 5 | ST7789_MIRROR_X << 6 | ST7789_MIRROR_Y << 7));
+    CHECK((st7789_sim_colmod() & 0x07) == ST7789_PIXEL_FORMAT);
+    CHECK(!st7789_sim_sleeping());
+    CHECK(st7789_sim_display_on());
+    CHECK(st7789_sim_inverted());
+    CHECK(st7789_sim_stats().delay_ms == 170);
+    // One chip select frame per command
+    CHECK(st7789_sim_stats().cs_frames == 16);
+}
+
+static void test_fill(void) {
+    const uint16_t width = SCREEN_WIDTH;
+    const uint16_t height = SCREEN_HEIGHT;
+    st7789_sim_clear_gram(0);
+
+    st7789_sim_reset_stats();
+    fill_rows(0, 0, width, height, 0x20, 0x40, 0x80);
+    st7789_sim_stats_t full = st7789_sim_stats();
+    st7789_sim_print_stats(stdout, "full screen", full);
+    CHECK(full.pixels == (uint64_t)width * height);
+    CHECK(count_color(gram_color(0x20, 0x40, 0x80)) == (size_t)width * height);
+
+    st7789_sim_reset_stats();
+    ST7789_SetWriteArea(&hspi1, 10, 20, 30, 40);
+    st7789_sim_stats_t area = st7789_sim_stats();
+    st7789_sim_print_stats(stdout, "set write area", area);
+    CHECK(area.cs_frames <= 3);
+    CHECK(area.bytes == 11);
+
+    st7789_sim_reset_stats();
+    fill_rows(10, 20, 30, 40, 0xff, 0x00, 0x00);
+    st7789_sim_print_stats(stdout, "30x40 rect", st7789_sim_stats());
+    CHECK(count_color(gram_color(0xff, 0x00, 0x00)) == 30 * 40);
+    CHECK(count_color(gram_color(0x20, 0x40, 0x80)) == (size_t)width * height - 30 * 40);
+
+    st7789_sim_reset_stats();
+    fill_rows(width - 1, height - 1, 1, 1, 0x00, 0xff, 0x00);
+    st7789_sim_print_stats(stdout, "1x1 rect", st7789_sim_stats());
+
+    // The report follows the configured clock
+    char report[256];
+    FILE* file = fmemopen(report, sizeof(report), "w");
+    st7789_sim_set_spi_hz(21000000);
+    st7789_sim_print_stats(file, "full screen", full);
+    st7789_sim_set_spi_hz(ST7789_SIM_SPI_HZ);
+    fclose(file);
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%9.3lf ms at 21 MHz", 1000.0 * st7789_sim_wire_time(full, 21000000, 0));
+    CHECK(strstr(report, expected) != NULL);
+
+    double wire = st7789_sim_wire_time(full, 21000000, 0);
+    printf("Full screen wire time: %.3lf ms at 21 MHz, %.3lf ms at 42 MHz (%.1lf fps)\n",
+        1000.0 * wire, 500.0 * wire, 2.0 / wire);
+}
+
+// Any byte pattern is a valid pixel stream, GRAM is compared between paths
+static void render_band(uint8_t* buf, size_t size, uint16_t y, int frame) {
+    for (size_t i = 0; i < size; i++)
+        buf[i] = (uint8_t)(i * 7 + y * 13 + frame * 31);
+}
+
+static const size_t BAND_ROWS = ST7789_DMA_BUFFER_SIZE / ST7789_WIRE_BYTES(SCREEN_WIDTH);
+
+static void frame_blocking(int frame) {
+    static uint8_t band[ST7789_DMA_BUFFER_SIZE];
+    for (uint16_t y = 0; y < SCREEN_HEIGHT; y += BAND_ROWS) {
+        uint16_t rows = SCREEN_HEIGHT - y < BAND_ROWS ? SCREEN_HEIGHT - y : BAND_ROWS;
+        size_t size = ST7789_WIRE_BYTES(SCREEN_WIDTH * rows);
+        render_band(band, size, y, frame);
+        st7789_sim_cpu(RENDER_SECONDS_PER_PIXEL * SCREEN_WIDTH * rows);
+        ST7789_SetWriteArea(&hspi1, 0, y, SCREEN_WIDTH, rows);
+        ST7789_Transmit(&hspi1, band, size, ST7789_SPI_TIMEOUT);
+    }
+}
+
+static void frame_dma(int frame) {
+    for (uint16_t y = 0; y < SCREEN_HEIGHT; y += BAND_ROWS) {
+        uint16_t rows = SCREEN_HEIGHT - y < BAND_ROWS ? SCREEN_HEIGHT - y : BAND_ROWS;
+        size_t size = ST7789_WIRE_BYTES(SCREEN_WIDTH * rows);
+        uint8_t* band = ST7789_DMA_AcquireBuffer(&hst7789);
+        render_band(band, size, y, frame);
+        st7789_sim_cpu(RENDER_SECONDS_PER_PIXEL * SCREEN_WIDTH * rows);
+        ST7789_DMA_Submit(&hst7789, 0, y, SCREEN_WIDTH, rows, band, size);
+    }
+}
+
+// Each band sent as two windows from the same line buffer
+static void frame_dma_split(int frame) {
+    for (uint16_t y = 0; y < SCREEN_HEIGHT; y += BAND_ROWS) {
+        uint16_t rows = SCREEN_HEIGHT - y < BAND_ROWS ? SCREEN_HEIGHT - y : BAND_ROWS;
+        uint16_t top = rows / 2;
+        uint8_t* band = ST7789_DMA_AcquireBuffer(&hst7789);
+        render_band(band, ST7789_WIRE_BYTES(SCREEN_WIDTH * rows), y, frame);
+        st7789_sim_cpu(RENDER_SECONDS_PER_PIXEL * SCREEN_WIDTH * rows);
+        size_t offset = ST7789_WIRE_BYTES(SCREEN_WIDTH * top);
+        ST7789_DMA_Submit(&hst7789, 0, y, SCREEN_WIDTH, top, band, offset);
+        ST7789_DMA_Submit(&hst7789, 0, y + top, SCREEN_WIDTH, rows - top, band + offset,
+            ST7789_WIRE_BYTES(SCREEN_WIDTH * rows) - offset);
+    }
+}
+
+static void test_dma(void) {
+    static uint32_t reference[ST7789_SIM_GRAM_WIDTH * ST7789_SIM_GRAM_HEIGHT];
+    const int frames = 10;
+    ST7789_DMA_Init(&hst7789, &hspi1);
+
+    // Same frames through both paths must leave the same GRAM
+    for (int frame = 0; frame < 2; frame++) {
+        frame_blocking(frame);
+        memcpy(reference, st7789_sim_gram(), sizeof(reference));
+        st7789_sim_clear_gram(0);
+        frame_dma(frame);
+        ST7789_DMA_Wait(&hst7789);
+        CHECK(memcmp(reference, st7789_sim_gram(), sizeof(reference)) == 0);
+
+        // A buffer must not be reused while its second window is queued
+        st7789_sim_clear_gram(0);
+        frame_dma_split(frame);
+        ST7789_DMA_Wait(&hst7789);
+        CHECK(memcmp(reference, st7789_sim_gram(), sizeof(reference)) == 0);
+    }
+
+    // A start failing in the completion interrupt drops the queue and is
+    // reported by Wait instead of leaving it asleep; the second job fails
+    // on its second of six stages
+    st7789_sim_fail_dma(7);
+    frame_dma(0);
+    CHECK(ST7789_DMA_Wait(&hst7789) == HAL_ERROR);
+    CHECK(!ST7789_DMA_Busy(&hst7789) && (ST7789_CS_GPIO->ODR & ST7789_CS_PIN));
+    CHECK(hst7789.buffer_jobs[0] == 0 && hst7789.buffer_jobs[1] == 0);
+    CHECK(ST7789_DMA_Wait(&hst7789) == HAL_OK);
+
+    // A failed first start is returned by Submit
+    st7789_sim_fail_dma(0);
+    uint8_t* band = ST7789_DMA_AcquireBuffer(&hst7789);
+    CHECK(ST7789_DMA_Submit(&hst7789, 0, 0, SCREEN_WIDTH, 1, band, ST7789_WIRE_BYTES(SCREEN_WIDTH)) == HAL_ERROR);
+    CHECK(!ST7789_DMA_Busy(&hst7789) && (ST7789_CS_GPIO->ODR & ST7789_CS_PIN));
+    CHECK(hst7789.buffer_jobs[0] == 0 && hst7789.buffer_jobs[1] == 0);
+    CHECK(ST7789_DMA_Wait(&hst7789) == HAL_ERROR);
+
+    // Streaming recovers
+    frame_dma(1);
+    CHECK(ST7789_DMA_Wait(&hst7789) == HAL_OK);
+    CHECK(memcmp(reference, st7789_sim_gram(), sizeof(reference)) == 0);
+
+    // An empty submit leaves nothing queued and the buffer reusable
+    for (int i = 0; i < 4; i++)
+        ST7789_DMA_Submit(&hst7789, 0, 0, 0, 0, ST7789_DMA_AcquireBuffer(&hst7789), 0);
+    CHECK(!ST7789_DMA_Busy(&hst7789) && (ST7789_CS_GPIO->ODR & ST7789_CS_PIN));
+    CHECK(hst7789.buffer_jobs[0] == 0 && hst7789.buffer_jobs[1] == 0);
+
+    double start = st7789_sim_time(), idle = st7789_sim_idle_time();
+    for (int frame = 0; frame < frames; frame++)
+        frame_blocking(frame);
+    double blocking_time = st7789_sim_time() - start;
+    printf("Blocking: %6.1lf fps, CPU idle %5.1lf%%\n", frames / blocking_time,
+        100.0 * (st7789_sim_idle_time() - idle) / blocking_time);
+
+    st7789_sim_reset_stats();
+    start = st7789_sim_time();
+    idle = st7789_sim_idle_time();
+    for (int frame = 0; frame < frames; frame++)
+        frame_dma(frame);
+    ST7789_DMA_Wait(&hst7789);
+    double dma_time = st7789_sim_time() - start;
+    st7789_sim_stats_t dma_stats = st7789_sim_stats();
+    printf("DMA:      %6.1lf fps, CPU idle %5.1lf%%\n", frames / dma_time,
+        100.0 * (st7789_sim_idle_time() - idle) / dma_time);
+    st7789_sim_print_stats(stdout, "DMA frames", dma_stats);
+
+    CHECK(dma_stats.busy_errors == 0);
+    CHECK(dma_stats.pixels == (uint64_t)frames * SCREEN_WIDTH * SCREEN_HEIGHT);
+    CHECK(dma_time < blocking_time);
+}
+
+// Per pixel reference packing, any format
+static size_t ref_pack(uint8_t format, uint8_t* dst, const uint32_t* src, size_t n) {
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t r = src[i] >> 16, g = src[i] >> 8, b = src[i];
+        if (format == ST7789_PIXEL_FORMAT_12BIT) {
+            if (i % 2 == 0) {
+                dst[len++] = (r & 0xf0) | g >> 4;
+                dst[len++] = b & 0xf0;
+            } else {
+                dst[len - 1] |= r >> 4;
+                dst[len++] = (g & 0xf0) | b >> 4;
+            }
+        } else if (format == ST7789_PIXEL_FORMAT_16BIT) {
+            uint16_t v = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+            dst[len++] = v >> 8;
+            dst[len++] = v & 0xff;
+        } else {
+            dst[len++] = r & 0xfc;
+            dst[len++] = g & 0xfc;
+            dst[len++] = b & 0xfc;
+        }
+    }
+    return len;
+}
+
+// GRAM value the simulator stores for an ARGB color in any format
+static uint32_t ref_gram(uint8_t format, uint32_t argb) {
+    uint32_t r = argb >> 16 & 0xff, g = argb >> 8 & 0xff, b = argb & 0xff;
+    if (format == ST7789_PIXEL_FORMAT_12BIT) {
+        r = (r >> 4) << 2, g = (g >> 4) << 2, b = (b >> 4) << 2;
+    } else if (format == ST7789_PIXEL_FORMAT_16BIT) {
+        r = (r >> 3) << 1, g = g >> 2, b = (b >> 3) << 1;
+    } else {
+        r >>= 2, g >>= 2, b >>= 2;
+    }
+    return (r << 2 | r >> 4) << 16 | (g << 2 | g >> 4) << 8 | (b << 2 | b >> 4);
+}
+
+typedef uint32_t (*pack_argb_t)(uint8_t* dst, const uint32_t* src, uint32_t n);
+typedef uint32_t (*pack_rgb_t)(uint8_t* dst, const uint8_t* src, uint32_t n);
+
+static const struct {
+    const char* name;
+    uint8_t format;
+    pack_argb_t argb, argb_word;
+    pack_rgb_t rgb, rgb_word;
+} PACKERS[] = {
+    {"12-bit", ST7789_PIXEL_FORMAT_12BIT, ST7789_PackARGB12, ST7789_PackARGB12_Word, ST7789_PackRGB12, ST7789_PackRGB12_Word},
+    {"16-bit", ST7789_PIXEL_FORMAT_16BIT, ST7789_PackARGB16, ST7789_PackARGB16_Word, ST7789_PackRGB16, ST7789_PackRGB16_Word},
+    {"18-bit", ST7789_PIXEL_FORMAT_18BIT, ST7789_PackARGB18, ST7789_PackARGB18_Word, ST7789_PackRGB18, ST7789_PackRGB18},
+};
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void test_color(void) {
+    enum { N = SCREEN_WIDTH * SCREEN_HEIGHT };
+    static uint32_t argb[N];
+    static uint8_t rgb[N * 3], expected[N * 3 + 16], packed[N * 3 + 16], word[N * 3 + 16];
+    uint32_t seed = 1;
+    for (size_t i = 0; i < N; i++) {
+        seed = seed * 1103515245 + 12345;
+        argb[i] = seed ^ seed >> 16;
+        rgb[3 * i] = argb[i] >> 16;
+        rgb[3 * i + 1] = argb[i] >> 8;
+        rgb[3 * i + 2] = argb[i];
+    }
+
+    // Kernels against the reference, every tail length and a misaligned source
+    for (size_t k = 0; k < sizeof(PACKERS) / sizeof(PACKERS[0]); k++) {
+        for (uint32_t n = 0; n <= 70; n++) {
+            for (uint32_t offset = 0; offset < 2; offset++) {
+                size_t len = ref_pack(PACKERS[k].format, expected, argb + offset, n);
+                memset(packed, 0xAA, len + 16);
+                CHECK(PACKERS[k].argb(packed, argb + offset, n) == len);
+                CHECK(memcmp(packed, expected, len) == 0);
+                CHECK(packed[len] == 0xAA);
+                CHECK(PACKERS[k].argb_word(word, argb + offset, n) == len);
+                CHECK(memcmp(word, expected, len) == 0);
+                memset(packed, 0xAA, len + 16);
+                CHECK(PACKERS[k].rgb(packed, rgb + 3 * offset, n) == len);
+                CHECK(memcmp(packed, expected, len) == 0);
+                CHECK(packed[len] == 0xAA);
+                CHECK(PACKERS[k].rgb_word(word, rgb + 3 * offset, n) == len);
+                CHECK(memcmp(word, expected, len) == 0);
+            }
+        }
+    }
+
+    // Through the controller in every format, odd pixel counts included
+    static const uint8_t gram_window[8] = {0, 0, 0, ST7789_SIM_GRAM_WIDTH - 1, 0, 0, 0, 4};
+    const uint8_t madctl = 0, ramwr_x[4] = {0, 0, 0, 6}, ramwr_y[4] = {0, 0, 0, 2};
+    for (size_t k = 0; k < sizeof(PACKERS) / sizeof(PACKERS[0]); k++) {
+        uint8_t format = PACKERS[k].format;
+        ST7789_CommandFrame(&hspi1, 0x36, &madctl, 1);
+        ST7789_CommandFrame(&hspi1, 0x3A, &format, 1);
+        ST7789_CommandFrame(&hspi1, 0x2A, &gram_window[0], 4);
+        ST7789_CommandFrame(&hspi1, 0x2B, &gram_window[4], 4);
+        ST7789_CommandFrame(&hspi1, 0x2C, NULL, 0);
+        uint32_t len = PACKERS[k].argb(packed, argb, ST7789_SIM_GRAM_WIDTH * 5);
+        ST7789_Transmit(&hspi1, packed, len, ST7789_SPI_TIMEOUT);
+        bool same = true;
+        for (size_t i = 0; i < ST7789_SIM_GRAM_WIDTH * 5; i++)
+            same &= st7789_sim_gram()[i] == ref_gram(format, argb[i]);
+        CHECK(same);
+
+        // 7x3 window, 21 pixels
+        ST7789_CommandFrame(&hspi1, 0x2A, ramwr_x, 4);
+        ST7789_CommandFrame(&hspi1, 0x2B, ramwr_y, 4);
+        ST7789_CommandFrame(&hspi1, 0x2C, NULL, 0);
+        len = PACKERS[k].argb(packed, argb + 1000, 21);
+        ST7789_Transmit(&hspi1, packed, len, ST7789_SPI_TIMEOUT);
+        same = true;
+        for (size_t i = 0; i < 21; i++)
+            same &= st7789_sim_gram()[(i / 7) * ST7789_SIM_GRAM_WIDTH + i % 7] == ref_gram(format, argb[1000 + i]);
+        CHECK(same);
+    }
+    const uint8_t config_madctl = ST7789_EXCHANGE_XY << 5 | ST7789_MIRROR_X << 6 | ST7789_MIRROR_Y << 7;
+    const uint8_t config_colmod = ST7789_PIXEL_FORMAT;
+    ST7789_CommandFrame(&hspi1, 0x36, &config_madctl, 1);
+    ST7789_CommandFrame(&hspi1, 0x3A, &config_colmod, 1);
+    st7789_sim_clear_gram(0);
+
+    // Throughput over full screens
+    const int rounds = 64;
+    for (size_t k = 0; k < sizeof(PACKERS) / sizeof(PACKERS[0]); k++) {
+        double t[4];
+        for (int path = 0; path < 4; path++) {
+            double start = seconds();
+            for (int round = 0; round < rounds; round++) {
+                if (path == 0)
+                    PACKERS[k].argb(packed, argb, N);
+                else if (path == 1)
+                    PACKERS[k].argb_word(packed, argb, N);
+                else if (path == 2)
+                    PACKERS[k].rgb(packed, rgb, N);
+                else
+                    PACKERS[k].rgb_word(packed, rgb, N);
+                __asm__ volatile("" : : "r"(packed) : "memory");
+            }
+            t[path] = (seconds() - start) / rounds;
+        }
+        printf("Pack %s: ARGB %7.1lf Mpx/s (%.3lf ms/frame), ARGB word %7.1lf Mpx/s, RGB %7.1lf Mpx/s, RGB word %7.1lf Mpx/s, %u bytes/frame\n",
+            PACKERS[k].name, N / t[0] * 1e-6, t[0] * 1e3, N / t[1] * 1e-6, N / t[2] * 1e-6, N / t[3] * 1e-6,
+            (unsigned)ref_pack(PACKERS[k].format, expected, argb, N));
+    }
+#if defined(__SSSE3__)
+    printf("Pack kernels: SSSE3\n");
+#else
+    printf("Pack kernels: word at a time\n");
+#endif
+}
+
+// Logical screen model for the primitives, pushed whole to compare GRAM
+static uint32_t model[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+static void model_push(void) {
+    static uint8_t wire[ST7789_WIRE_BYTES(SCREEN_WIDTH * 8)];
+    ST7789_SetWriteArea(&hspi1, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    for (uint16_t y = 0; y < SCREEN_HEIGHT; y += 8) {
+        uint16_t rows = SCREEN_HEIGHT - y < 8 ? SCREEN_HEIGHT - y : 8;
+        uint32_t size = ST7789_PackARGB(wire, model + y * SCREEN_WIDTH, SCREEN_WIDTH * rows);
+        ST7789_Transmit(&hspi1, wire, size, ST7789_SPI_TIMEOUT);
+    }
+}
+
+static void model_blit(int x, int y, int w, int h, const uint32_t* pixels, ST7789_RectTypeDef clip) {
+    for (int row = 0; row < h; row++) {
+        for (int col = 0; col < w; col++) {
+            int px = x + col, py = y + row;
+            if (px >= clip.x && px < clip.x + clip.w && py >= clip.y && py < clip.y + clip.h &&
+                px >= 0 && px < SCREEN_WIDTH && py >= 0 && py < SCREEN_HEIGHT)
+                model[py * SCREEN_WIDTH + px] = pixels ? pixels[row * w + col] : model[py * SCREEN_WIDTH + px];
+        }
+    }
+}
+
+static void model_fill(int x, int y, int w, int h, uint32_t argb) {
+    for (int py = y; py < y + h && py < SCREEN_HEIGHT; py++)
+        for (int px = x; px < x + w && px < SCREEN_WIDTH; px++)
+            model[py * SCREEN_WIDTH + px] = argb;
+}
+
+static void model_text(int x, int y, const char* text, uint32_t fg, uint32_t bg) {
+    for (int i = 0; text[i]; i++)
+        for (int col = 0; col < ST7789_FONT_CELL_WIDTH; col++)
+            for (int row = 0; row < ST7789_FONT_CELL_HEIGHT; row++) {
+                bool on = col < ST7789_FONT_WIDTH && (ST7789_FONT_5X7[text[i] - 0x20][col] >> row & 1);
+                model_fill(x + i * ST7789_FONT_CELL_WIDTH + col, y + row, 1, 1, on ? fg : bg);
+            }
+}
+
+static st7789_sim_stats_t gfx_report(const char* label) {
+    st7789_sim_stats_t stats = st7789_sim_stats();
+    st7789_sim_print_stats(stdout, label, stats);
+    st7789_sim_reset_stats();
+    return stats;
+}
+
+static void test_gfx(void) {
+    static uint32_t reference[ST7789_SIM_GRAM_WIDTH * ST7789_SIM_GRAM_HEIGHT];
+    static uint32_t sprite[21 * 13];
+    const ST7789_RectTypeDef window = {155, 25, 10, 7};
+    const char* text = "Hello, ST7789! 0123";
+    const char* edge = "clipped at the edge";
+    st7789_sim_stats_t stats;
+
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++)
+        model[i] = (i % SCREEN_WIDTH) << 16 | (i / SCREEN_WIDTH) << 8 | 0x40;
+    for (int i = 0; i < 21 * 13; i++)
+        sprite[i] = (uint32_t)i * 0x010305 ^ 0x804020;
+    model_push();
+
+    // Primitives against the panel
+    st7789_sim_reset_stats();
+    ST7789_FillRect(&hspi1, 10, 10, 100, 50, 0xFF0000);
+    stats = gfx_report("gfx fill 100x50");
+    CHECK(stats.bytes == 11 + ST7789_WIRE_BYTES(100 * 50));
+    CHECK(stats.pixels == 100 * 50);
+    ST7789_FillRect(&hspi1, SCREEN_WIDTH - 21, SCREEN_HEIGHT - 9, 50, 50, 0x00FF00);
+    stats = gfx_report("gfx fill clipped 21x9");
+    CHECK(stats.pixels == 21 * 9);
+    ST7789_DrawHLine(&hspi1, 0, 70, SCREEN_WIDTH, 0xFFFFFF);
+    gfx_report("gfx hline");
+    ST7789_DrawVLine(&hspi1, 120, 0, SCREEN_HEIGHT, 0x0000FF);
+    gfx_report("gfx vline");
+    ST7789_Blit(&hspi1, -5, 100, 21, 13, sprite, ST7789_GFX_SCREEN);
+    stats = gfx_report("gfx blit 16x13 of 21x13");
+    CHECK(stats.pixels == 16 * 13);
+    ST7789_Blit(&hspi1, 150, 20, 21, 13, sprite, window);
+    stats = gfx_report("gfx blit clip rect");
+    CHECK(stats.pixels == 10 * 7);
+    ST7789_DrawString(&hspi1, 4, 80, text, 0xFFFF00, 0x000000);
+    stats = gfx_report("gfx text 19 chars");
+    // One window per string
+    CHECK(stats.commands == 3);
+    CHECK(stats.pixels == strlen(text) * ST7789_FONT_CELL_WIDTH * ST7789_FONT_CELL_HEIGHT);
+    ST7789_DrawString(&hspi1, SCREEN_WIDTH - 40, SCREEN_HEIGHT - 8, edge, 0x00FFFF, 0x202020);
+    stats = gfx_report("gfx text clipped");
+    CHECK(stats.pixels == 40 * 8);
+    memcpy(reference, st7789_sim_gram(), sizeof(reference));
+
+    // Same operations on the model must leave the same GRAM
+    model_fill(10, 10, 100, 50, 0xFF0000);
+    model_fill(SCREEN_WIDTH - 21, SCREEN_HEIGHT - 9, 50, 50, 0x00FF00);
+    model_fill(0, 70, SCREEN_WIDTH, 1, 0xFFFFFF);
+    model_fill(120, 0, 1, SCREEN_HEIGHT, 0x0000FF);
+    model_blit(-5, 100, 21, 13, sprite, ST7789_GFX_SCREEN);
+    model_blit(150, 20, 21, 13, sprite, window);
+    model_text(4, 80, text, 0xFFFF00, 0x000000);
+    model_text(SCREEN_WIDTH - 40, SCREEN_HEIGHT - 8, edge, 0x00FFFF, 0x202020);
+    st7789_sim_clear_gram(0);
+    model_push();
+    CHECK(memcmp(reference, st7789_sim_gram(), sizeof(reference)) == 0);
+
+    // Full screen fill from the pattern buffer
+    st7789_sim_reset_stats();
+    ST7789_FillRect(&hspi1, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0x102030);
+    stats = gfx_report("gfx fill screen");
+    CHECK(count_color(gram_color(0x10, 0x20, 0x30)) == (size_t)SCREEN_WIDTH * SCREEN_HEIGHT);
+    printf("Fill buffer: %u bytes for a %u byte screen\n",
+        (unsigned)ST7789_WIRE_BYTES(ST7789_GFX_BUFFER_PIXELS), (unsigned)ST7789_WIRE_BYTES(SCREEN_WIDTH * SCREEN_HEIGHT));
+}
+
+#if ST7789_PIXEL_FORMAT != ST7789_PIXEL_FORMAT_12BIT
+// Dashboard: static background, a few small widgets change every frame
+typedef struct {
+    ST7789_RectTypeDef rect;
+    uint8_t r, g, b;
+} widget_t;
+
+static widget_t dashboard[] = {
+    {{8, 8, 64, 16}},       // Clock
+    {{160, 8, 72, 16}},     // Value
+    {{160, 26, 72, 16}},    // Value, right below
+    {{8, 100, 120, 8}},     // Progress bar
+    {{224, 120, 6, 6}},     // Status dot
+};
+#define DASHBOARD_WIDGETS (sizeof(dashboard) / sizeof(dashboard[0]))
+
+static void dashboard_update(int frame) {
+    for (size_t i = 0; i < DASHBOARD_WIDGETS; i++) {
+        dashboard[i].r = (uint8_t)(frame * 37 + i * 50);
+        dashboard[i].g = (uint8_t)(frame * 11 + i * 90);
+        dashboard[i].b = (uint8_t)(frame * 5 + i * 20);
+    }
+}
+
+static void dashboard_pixel(uint8_t* out, uint16_t x, uint16_t y) {
+    for (size_t i = 0; i < DASHBOARD_WIDGETS; i++) {
+        ST7789_RectTypeDef r = dashboard[i].rect;
+        if (x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h) {
+            pack_color(out, 1, dashboard[i].r, dashboard[i].g, dashboard[i].b);
+            return;
+        }
+    }
+    pack_color(out, 1, x, y, 0x40);
+}
+
+static void dashboard_render(void* context, ST7789_RectTypeDef rect, uint8_t* out) {
+    (void)context;
+    for (uint16_t y = rect.y; y < rect.y + rect.h; y++)
+        for (uint16_t x = rect.x; x < rect.x + rect.w; x++, out += ST7789_FB_BYTES_PER_PIXEL)
+            dashboard_pixel(out, x, y);
+}
+
+static void dashboard_draw(ST7789_FB_HandleTypeDef* hfb) {
+    uint8_t color[ST7789_FB_BYTES_PER_PIXEL];
+    for (size_t i = 0; i < DASHBOARD_WIDGETS; i++) {
+        ST7789_RectTypeDef r = dashboard[i].rect;
+        if (hfb->pixels) {
+            pack_color(color, 1, dashboard[i].r, dashboard[i].g, dashboard[i].b);
+            ST7789_FB_FillRect(hfb, r.x, r.y, r.w, r.h, color);
+        } else {
+            ST7789_FB_Invalidate(hfb, r.x, r.y, r.w, r.h);
+        }
+    }
+}
+
+static void test_framebuffer(void) {
+    static uint8_t pixels[ST7789_FB_SIZE];
+    static uint8_t tile[2048];
+    static uint32_t reference[ST7789_SIM_GRAM_WIDTH * ST7789_SIM_GRAM_HEIGHT];
+    const int frames = 10;
+    ST7789_FB_HandleTypeDef fb, tiled;
+
+    // Dirty list: contained rects are absorbed, distant ones stay apart
+    ST7789_FB_Init(&fb, &hspi1, pixels);
+    ST7789_FB_Invalidate(&fb, 0, 0, 10, 10);
+    ST7789_FB_Invalidate(&fb, 200, 100, 10, 10);
+    ST7789_FB_Invalidate(&fb, 2, 2, 3, 3);
+    CHECK(fb.dirty_count == 2);
+    // Touching rects of the same height merge
+    ST7789_FB_Invalidate(&fb, 10, 0, 10, 10);
+    CHECK(fb.dirty_count == 2);
+    ST7789_RectTypeDef merged = fb.dirty[fb.dirty_count - 1];
+    CHECK(merged.x == 0 && merged.y == 0 && merged.w == 20 && merged.h == 10);
+    // Clipped to the screen
+    ST7789_FB_Invalidate(&fb, SCREEN_WIDTH - 4, SCREEN_HEIGHT - 4, 100, 100);
+    CHECK(fb.dirty[fb.dirty_count - 1].w == 4 && fb.dirty[fb.dirty_count - 1].h == 4);
+    for (uint16_t i = 0; i < 20; i++)
+        ST7789_FB_Invalidate(&fb, i * 11, (i % 4) * 30, 2, 2);
+    CHECK(fb.dirty_count <= ST7789_FB_MAX_DIRTY);
+    for (uint8_t i = 0; i < fb.dirty_count; i++)
+        for (uint8_t j = i + 1; j < fb.dirty_count; j++)
+            CHECK(!ST7789_FB_RectOverlap(fb.dirty[i], fb.dirty[j]));
+
+    // Crossing rects that are cheaper apart send their overlap once
+    ST7789_FB_Init(&fb, &hspi1, pixels);
+    ST7789_FB_Invalidate(&fb, 0, 0, 100, 10);
+    ST7789_FB_Invalidate(&fb, 50, 0, 10, 100);
+    CHECK(fb.dirty_count == 2);
+    st7789_sim_reset_stats();
+    ST7789_FB_Flush(&fb);
+    CHECK(st7789_sim_stats().pixels == 100 * 10 + 10 * 90);
+
+    // A tile smaller than a row is rejected and flushes nothing
+    CHECK(ST7789_FB_InitTiled(&tiled, &hspi1, tile, 16, dashboard_render, NULL) == HAL_ERROR);
+    ST7789_FB_InvalidateAll(&tiled);
+    st7789_sim_reset_stats();
+    ST7789_FB_Flush(&tiled);
+    CHECK(st7789_sim_stats().pixels == 0);
+
+    // Full frame, then widget updates through the dirty list
+    ST7789_FB_Init(&fb, &hspi1, pixels);
+    dashboard_update(0);
+    for (uint16_t y = 0; y < SCREEN_HEIGHT; y++)
+        for (uint16_t x = 0; x < SCREEN_WIDTH; x++)
+            dashboard_pixel(ST7789_FB_Pixel(&fb, x, y), x, y);
+    ST7789_FB_InvalidateAll(&fb);
+    ST7789_FB_Flush(&fb);
+
+    st7789_sim_reset_stats();
+    for (int frame = 1; frame <= frames; frame++) {
+        dashboard_update(frame);
+        dashboard_draw(&fb);
+        ST7789_FB_Flush(&fb);
+    }
+    st7789_sim_stats_t dirty = st7789_sim_stats();
+    memcpy(reference, st7789_sim_gram(), sizeof(reference));
+
+    // Same framebuffer sent whole must leave the same GRAM
+    st7789_sim_clear_gram(0);
+    st7789_sim_reset_stats();
+    ST7789_FB_InvalidateAll(&fb);
+    ST7789_FB_Flush(&fb);
+    st7789_sim_stats_t full = st7789_sim_stats();
+    CHECK(memcmp(reference, st7789_sim_gram(), sizeof(reference)) == 0);
+
+    // Tiled mode renders the same frames from a 2 KiB tile
+    st7789_sim_clear_gram(0);
+    CHECK(ST7789_FB_InitTiled(&tiled, &hspi1, tile, sizeof(tile), dashboard_render, NULL) == HAL_OK);
+    dashboard_update(0);
+    ST7789_FB_InvalidateAll(&tiled);
+    ST7789_FB_Flush(&tiled);
+    st7789_sim_reset_stats();
+    for (int frame = 1; frame <= frames; frame++) {
+        dashboard_update(frame);
+        dashboard_draw(&tiled);
+        ST7789_FB_Flush(&tiled);
+    }
+    st7789_sim_stats_t dirty_tiled = st7789_sim_stats();
+    CHECK(memcmp(reference, st7789_sim_gram(), sizeof(reference)) == 0);
+
+    st7789_sim_print_stats(stdout, "dirty frames", dirty);
+    st7789_sim_print_stats(stdout, "dirty frames, tiled", dirty_tiled);
+    st7789_sim_print_stats(stdout, "full frame", full);
+    double dirty_time = st7789_sim_wire_time(dirty, st7789_sim_spi_hz(), 1e-6) / frames;
+    double full_time = st7789_sim_wire_time(full, st7789_sim_spi_hz(), 1e-6);
+    printf("Dashboard at %g MHz: full %.1lf fps, dirty %.1lf fps (%.1lfx), %u B framebuffer or %u B tile\n",
+        st7789_sim_spi_hz() / 1e6, 1.0 / full_time, 1.0 / dirty_time, full_time / dirty_time, (unsigned)sizeof(pixels), (unsigned)sizeof(tile));
+    CHECK(dirty.pixels * 5 < full.pixels * frames);
+    CHECK(full_time > 4 * dirty_time);
+}
+#endif
+
+int main(int argc, char** argv) {
+    test_init();
+    test_fill();
+    test_dma();
+    test_color();
+    test_gfx();
+#if ST7789_PIXEL_FORMAT != ST7789_PIXEL_FORMAT_12BIT
+    test_framebuffer();
+#endif
+
+    if (argc > 1 && !st7789_sim_dump_ppm(argv[1])) {
+        printf("Failed to write %s\n", argv[1]);
+        failures++;
+    }
+
+    if (failures) {
+        printf("Test FAIL (%d).\n", failures);
+        return 1;
+    }
+    printf("Test PASS.\n");
+    return 0;
+}
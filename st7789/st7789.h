@@ -43,6 +43,12 @@
 /* SPI Interface Setting */
 #define ST7789_SPI_TIMEOUT (1000)
 
+/* DMA Streaming Setting */
+// Size of each of the two line buffers in bytes, 8 lines of 18-bit pixels by default
+#define ST7789_DMA_BUFFER_SIZE (ST7789_MEM_Y_SIZE * 3 * 8)
+// Jobs that can wait for the SPI at once
+#define ST7789_DMA_QUEUE_SIZE (8)
+
 /*  =============================
  *      ST7789 Implementation
  *  ============================= */
@@ -83,8 +89,9 @@ static inline void ST7789_SetBacklight(const bool on) {
 /// Transmit data to ST7789
 static inline HAL_StatusTypeDef ST7789_Transmit(SPI_HandleTypeDef* hspi, const uint8_t* data, uint16_t size, uint16_t timeout) {
     ST7789_ChipSelect(true);
-    return HAL_SPI_Transmit(hspi, data, size, timeout);
+    HAL_StatusTypeDef status = HAL_SPI_Transmit(hspi, data, size, timeout);
     ST7789_ChipSelect(false);
+    return status;
 }
 
 /// Transmit a 8 bit data to ST7789
@@ -92,98 +99,85 @@ static inline HAL_StatusTypeDef ST7789_Transmit8(SPI_HandleTypeDef* hspi, uint8_
     return ST7789_Transmit(hspi, &data, 1, ST7789_SPI_TIMEOUT);
 }
 
-/// Transmit a 16 bit data to ST7789
+/// Transmit a 16 bit data to ST7789, most significant byte first
 static inline HAL_StatusTypeDef ST7789_Transmit16(SPI_HandleTypeDef* hspi, uint16_t data) {
-    return ST7789_Transmit(hspi, (uint8_t*)&data, 2, ST7789_SPI_TIMEOUT);
+    const uint8_t bytes[2] = {data >> 8, data & 0xFF};
+    return ST7789_Transmit(hspi, bytes, 2, ST7789_SPI_TIMEOUT);
 }
 
-/// Transmit a 24 bit data to ST7789
+/// Transmit a 24 bit data to ST7789, most significant byte first
 static inline HAL_StatusTypeDef ST7789_Transmit24(SPI_HandleTypeDef* hspi, uint32_t data) {
-    return ST7789_Transmit(hspi, (uint8_t*)&data, 3, ST7789_SPI_TIMEOUT);
+    const uint8_t bytes[3] = {data >> 16 & 0xFF, data >> 8 & 0xFF, data & 0xFF};
+    return ST7789_Transmit(hspi, bytes, 3, ST7789_SPI_TIMEOUT);
 }
 
-/// Send a command to ST7789
-/// If argument is required, send arguments using ST7789_Transmit functions
-static inline void ST7789_Command(SPI_HandleTypeDef* hspi, uint8_t command) {
+/// Send a command and its arguments to ST7789 in one chip select frame
+/// D/C is low for the command byte and high for the arguments.
+static inline HAL_StatusTypeDef ST7789_CommandFrame(SPI_HandleTypeDef* hspi, uint8_t command, const uint8_t* args, uint16_t size) {
+    ST7789_ChipSelect(true);
     HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_RESET);
-    ST7789_Transmit8(hspi, command);
+    HAL_StatusTypeDef status = HAL_SPI_Transmit(hspi, &command, 1, ST7789_SPI_TIMEOUT);
     HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_SET);
+    if (status == HAL_OK && size)
+        status = HAL_SPI_Transmit(hspi, args, size, ST7789_SPI_TIMEOUT);
+    ST7789_ChipSelect(false);
+    return status;
 }
 
-const static uint8_t GAMMA_POS_SEQ[] = {0xD0, 0x04, 0x0D, 0x11, 0x13, 0x2B, 0x3F,
-                                        0x54, 0x4C, 0x18, 0x0D, 0x0B, 0x1F, 0x23};
-const static uint8_t GAMMA_NEG_SEQ[] = {0xD0, 0x04, 0x0D, 0x11, 0x13, 0x2B, 0x3F,
-                                        0x54, 0x4C, 0x18, 0x0D, 0x0B, 0x1F, 0x23};
-
-/// Initialize ST7789
-/// Notice: It is required to call ST7789_Reset() before ST7789 init
-static inline void ST7789_Init(SPI_HandleTypeDef* hspi) {
-
-#ifndef ST7789_HARDWARE_NSS
-    ST7789_ChipSelect(true);
-#endif
+/// Send a command to ST7789
+/// If argument is required, prefer ST7789_CommandFrame, or send arguments using ST7789_Transmit functions
+static inline void ST7789_Command(SPI_HandleTypeDef* hspi, uint8_t command) {
+    ST7789_CommandFrame(hspi, command, NULL, 0);
+}
 
+/// Init sequence, each entry is: command, argument count, delay after (ms), arguments
+const static uint8_t ST7789_INIT_SEQ[] = {
     // Memory Data Access Control
-    ST7789_Command(hspi, 0x36);
-    ST7789_Transmit8(hspi, ST7789_EXCHANGE_XY << 5 | ST7789_MIRROR_X << 6 | ST7789_MIRROR_Y << 7);
-
+    0x36, 1, 0, ST7789_EXCHANGE_XY << 5 | ST7789_MIRROR_X << 6 | ST7789_MIRROR_Y << 7,
     // Pixel Format
-    ST7789_Command(hspi, 0x3A);
-    ST7789_Transmit8(hspi, ST7789_PIXEL_FORMAT);
-
+    0x3A, 1, 0, ST7789_PIXEL_FORMAT,
     // Porch Setting
-    ST7789_Command(hspi, 0xB2);
-    ST7789_Transmit8(hspi, 0x0C);
-    ST7789_Transmit8(hspi, 0x0C);
-    ST7789_Transmit8(hspi, 0x00);
-    ST7789_Transmit8(hspi, 0x33);
-    ST7789_Transmit8(hspi, 0x33);
-
+    0xB2, 5, 0, 0x0C, 0x0C, 0x00, 0x33, 0x33,
     // Gate Control
-    ST7789_Command(hspi, 0xB7);
-    ST7789_Transmit8(hspi, 0x35);
-
+    0xB7, 1, 0, 0x35,
     // VCOMS Control
-    ST7789_Command(hspi, 0xBB);
-    ST7789_Transmit8(hspi, 0x19);
-
+    0xBB, 1, 0, 0x19,
     // LCM Control
-    ST7789_Command(hspi, 0xC0);
-    ST7789_Transmit8(hspi, 0x2C);
-
-    // Power - VDV/VRH Enable Type
-    ST7789_Command(hspi, 0xC2);
-    ST7789_Transmit8(hspi, 0x01); // VDV/VRH from command
-    ST7789_Transmit8(hspi, 0xFF);
-
+    0xC0, 1, 0, 0x2C,
+    // Power - VDV/VRH Enable Type, VDV/VRH from command
+    0xC2, 2, 0, 0x01, 0xFF,
     // Power - VRH Set
-    ST7789_Command(hspi, 0xC3);
-    ST7789_Transmit8(hspi, 0x12);
-
+    0xC3, 1, 0, 0x12,
     // Power - VDV Set
-    ST7789_Command(hspi, 0xC4);
-    ST7789_Transmit8(hspi, 0x20);
-
+    0xC4, 1, 0, 0x20,
     // Frame Rate Setting
-    ST7789_Command(hspi, 0xC6);
-    ST7789_Transmit8(hspi, 0x0F);
-
+    0xC6, 1, 0, 0x0F,
     // Power Control 1
-    ST7789_Command(hspi, 0xD0);
-    ST7789_Transmit8(hspi, 0xA4);
-    ST7789_Transmit8(hspi, 0xA1);
-
-    // Gamma Correction
-    ST7789_Command(hspi, 0xE0);
-    ST7789_Transmit(hspi, GAMMA_POS_SEQ, sizeof(GAMMA_POS_SEQ));
-    ST7789_Command(hspi, 0xE1);
-    ST7789_Transmit(hspi, GAMMA_NEG_SEQ, sizeof(GAMMA_NEG_SEQ));
-
+    0xD0, 2, 0, 0xA4, 0xA1,
+    // Positive Gamma Correction
+    0xE0, 14, 0, 0xD0, 0x04, 0x0D, 0x11, 0x13, 0x2B, 0x3F,
+                 0x54, 0x4C, 0x18, 0x0D, 0x0B, 0x1F, 0x23,
+    // Negative Gamma Correction
+    0xE1, 14, 0, 0xD0, 0x04, 0x0D, 0x11, 0x13, 0x2B, 0x3F,
+                 0x54, 0x4C, 0x18, 0x0D, 0x0B, 0x1F, 0x23,
     // Inverse Mode On
-    ST7789_Command(hspi, 0x21);
-
+    0x21, 0, 0,
     // Exit From Sleep
-    ST7789_Command(hspi, 0x11);
+    0x11, 0, 0,
+};
+
+/// Initialize ST7789
+/// Notice: It is required to call ST7789_Reset() before ST7789 init
+static inline void ST7789_Init(SPI_HandleTypeDef* hspi) {
+    for (uint16_t i = 0; i < sizeof(ST7789_INIT_SEQ); ) {
+        uint8_t command = ST7789_INIT_SEQ[i];
+        uint8_t size = ST7789_INIT_SEQ[i + 1];
+        uint8_t delay = ST7789_INIT_SEQ[i + 2];
+        ST7789_CommandFrame(hspi, command, &ST7789_INIT_SEQ[i + 3], size);
+        if (delay)
+            HAL_Delay(delay);
+        i += 3 + size;
+    }
 }
 
 /// Enable ST7789 Display
@@ -191,10 +185,19 @@ static inline void ST7789_SetDisplay(SPI_HandleTypeDef* hspi, const bool on) {
     ST7789_Command(hspi, on ? 0x29 : 0x28);
 }
 
-/// Set write area for ST7789 and begin writing data
+/// Screen size in display data direction
+#define ST7789_WIDTH (ST7789_EXCHANGE_XY ? ST7789_MEM_Y_SIZE : ST7789_MEM_X_SIZE)
+#define ST7789_HEIGHT (ST7789_EXCHANGE_XY ? ST7789_MEM_X_SIZE : ST7789_MEM_Y_SIZE)
+
+typedef struct {
+    uint16_t x, y, w, h;
+} ST7789_RectTypeDef;
+
+/// Window address for a write area, as CASET and RASET parameters
+/// address[0..3]: xs, xe and address[4..7]: ys, ye, big endian
 /// Coordinates are synced with display data direction settings
 /// For display data direction, refer to https://www.waveshare.com/w/upload/a/ae/ST7789_Datasheet.pdf#page=125
-static inline void ST7789_SetWriteArea(SPI_HandleTypeDef* hspi, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+static inline void ST7789_WindowAddress(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t address[8]) {
     uint16_t xs, xe, ys, ye;
     if (!ST7789_EXCHANGE_XY) {
         xs = !ST7789_MIRROR_X ?
@@ -225,17 +228,249 @@ static inline void ST7789_SetWriteArea(SPI_HandleTypeDef* hspi, uint16_t x, uint
     }
 
     // big endian transfer is required
-    ST7789_Command(hspi, 0x2A); // Column Address Set
-    ST7789_Transmit8(hspi, (xs >> 8) & 0xff);
-    ST7789_Transmit8(hspi, xs & 0xff);
-    ST7789_Transmit8(hspi, (xe >> 8) & 0xff);
-    ST7789_Transmit8(hspi, xe & 0xff);
-
-    ST7789_Command(hspi, 0x2B); // Row Address Set
-    ST7789_Transmit8(hspi, (ys >> 8) & 0xff);
-    ST7789_Transmit8(hspi, ys & 0xff);
-    ST7789_Transmit8(hspi, (ye >> 8) & 0xff);
-    ST7789_Transmit8(hspi, ye & 0xff);
-
-    ST7789_Command(hspi, 0x2C); // Memory Write
+    address[0] = (xs >> 8) & 0xff;
+    address[1] = xs & 0xff;
+    address[2] = (xe >> 8) & 0xff;
+    address[3] = xe & 0xff;
+    address[4] = (ys >> 8) & 0xff;
+    address[5] = ys & 0xff;
+    address[6] = (ye >> 8) & 0xff;
+    address[7] = ye & 0xff;
+}
+
+/// Set write area for ST7789 and begin writing data
+/// Coordinates are synced with display data direction settings
+/// Takes three chip select frames, pixels follow with ST7789_Transmit
+static inline void ST7789_SetWriteArea(SPI_HandleTypeDef* hspi, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    uint8_t address[8];
+    ST7789_WindowAddress(x, y, w, h, address);
+    ST7789_CommandFrame(hspi, 0x2A, &address[0], 4); // Column Address Set
+    ST7789_CommandFrame(hspi, 0x2B, &address[4], 4); // Row Address Set
+    ST7789_CommandFrame(hspi, 0x2C, NULL, 0);        // Memory Write
+}
+
+/*  =============================
+ *      ST7789 DMA Streaming
+ *  =============================
+ *  Write-area-plus-pixel jobs are queued and sent with HAL_SPI_Transmit_DMA.
+ *  Each DMA completion advances the current job one stage
+ *  (CASET, its address, RASET, its address, RAMWR, pixels), so the CPU
+ *  only waits when the queue or both line buffers are full.
+ *  Every wait checks its condition with interrupts masked before __WFI, so a
+ *  completion landing in between stays pending and wakes the core.
+ *  If a transfer fails to start, no completion would ever come: the queue is
+ *  dropped and the status kept for ST7789_DMA_Submit / ST7789_DMA_Wait.
+ *
+ *  Forward the HAL completion interrupt to the driver:
+ *      void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi) {
+ *          ST7789_DMA_TxCpltCallback(&hst7789, hspi);
+ *      }
+ */
+
+typedef enum {
+    ST7789_DMA_STAGE_IDLE,
+    ST7789_DMA_STAGE_CASET,
+    ST7789_DMA_STAGE_CASET_ADDRESS,
+    ST7789_DMA_STAGE_RASET,
+    ST7789_DMA_STAGE_RASET_ADDRESS,
+    ST7789_DMA_STAGE_RAMWR,
+    ST7789_DMA_STAGE_PIXELS,
+} ST7789_DMA_StageTypeDef;
+
+typedef struct {
+    uint16_t x, y, w, h;
+    const uint8_t* data;        // Wire format pixels
+    uint32_t size;              // Bytes
+    int8_t buffer;              // Line buffer released when done, -1 for caller memory
+} ST7789_DMA_JobTypeDef;
+
+typedef struct {
+    SPI_HandleTypeDef* hspi;
+    ST7789_DMA_JobTypeDef queue[ST7789_DMA_QUEUE_SIZE];
+    volatile uint8_t head;      // Advanced by the completion interrupt
+    volatile uint8_t tail;      // Advanced by submitters
+    volatile ST7789_DMA_StageTypeDef stage;
+    volatile HAL_StatusTypeDef error; // First failed start since the last ST7789_DMA_Wait
+    uint32_t sent;              // Pixel bytes of the current job already sent
+    uint8_t address[8];         // CASET / RASET parameters of the current job
+    uint8_t buffers[2][ST7789_DMA_BUFFER_SIZE];
+    volatile uint8_t buffer_jobs[2]; // Queued jobs reading each line buffer
+    uint8_t next_buffer;
+} ST7789_DMA_HandleTypeDef;
+
+const static uint8_t ST7789_DMA_COMMANDS[] = {0x2A, 0x2B, 0x2C};
+
+/// Initialize DMA streaming state, the SPI handle must have a TX DMA channel linked
+static inline void ST7789_DMA_Init(ST7789_DMA_HandleTypeDef* hdma, SPI_HandleTypeDef* hspi) {
+    hdma->hspi = hspi;
+    hdma->head = 0;
+    hdma->tail = 0;
+    hdma->stage = ST7789_DMA_STAGE_IDLE;
+    hdma->error = HAL_OK;
+    hdma->sent = 0;
+    hdma->buffer_jobs[0] = 0;
+    hdma->buffer_jobs[1] = 0;
+    hdma->next_buffer = 0;
+}
+
+/// Drop every queued job after a failed start and go idle
+/// Called with the completion interrupt masked or from it
+static inline void ST7789_DMA_Abort(ST7789_DMA_HandleTypeDef* hdma, HAL_StatusTypeDef status) {
+    ST7789_ChipSelect(false);
+    for (uint8_t i = hdma->head; i != hdma->tail; i = (i + 1) % ST7789_DMA_QUEUE_SIZE)
+        if (hdma->queue[i].buffer >= 0)
+            hdma->buffer_jobs[hdma->queue[i].buffer]--;
+    hdma->head = hdma->tail;
+    hdma->sent = 0;
+    hdma->stage = ST7789_DMA_STAGE_IDLE;
+    if (hdma->error == HAL_OK)
+        hdma->error = status;
+}
+
+/// Start the transfer for the current stage of the job at queue head
+/// Called with the SPI idle, from thread context or the completion interrupt
+static inline HAL_StatusTypeDef ST7789_DMA_StartStage(ST7789_DMA_HandleTypeDef* hdma) {
+    ST7789_DMA_JobTypeDef* job = &hdma->queue[hdma->head];
+    HAL_StatusTypeDef status = HAL_OK;
+    switch (hdma->stage) {
+        case ST7789_DMA_STAGE_CASET:
+            ST7789_WindowAddress(job->x, job->y, job->w, job->h, hdma->address);
+            ST7789_ChipSelect(true);
+            HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_RESET);
+            status = HAL_SPI_Transmit_DMA(hdma->hspi, &ST7789_DMA_COMMANDS[0], 1);
+            break;
+        case ST7789_DMA_STAGE_CASET_ADDRESS:
+            HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_SET);
+            status = HAL_SPI_Transmit_DMA(hdma->hspi, &hdma->address[0], 4);
+            break;
+        case ST7789_DMA_STAGE_RASET:
+            HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_RESET);
+            status = HAL_SPI_Transmit_DMA(hdma->hspi, &ST7789_DMA_COMMANDS[1], 1);
+            break;
+        case ST7789_DMA_STAGE_RASET_ADDRESS:
+            HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_SET);
+            status = HAL_SPI_Transmit_DMA(hdma->hspi, &hdma->address[4], 4);
+            break;
+        case ST7789_DMA_STAGE_RAMWR:
+            HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_RESET);
+            status = HAL_SPI_Transmit_DMA(hdma->hspi, &ST7789_DMA_COMMANDS[2], 1);
+            break;
+        case ST7789_DMA_STAGE_PIXELS: {
+            // A DMA transfer is limited to 65535 bytes
+            uint32_t size = job->size - hdma->sent;
+            if (size > 0xFFFF)
+                size = 0xFFFF;
+            HAL_GPIO_WritePin(ST7789_DC_GPIO, ST7789_DC_PIN, GPIO_PIN_SET);
+            status = HAL_SPI_Transmit_DMA(hdma->hspi, job->data + hdma->sent, size);
+            if (status == HAL_OK)
+                hdma->sent += size;
+            break;
+        }
+        default:
+            break;
+    }
+    if (status != HAL_OK)
+        ST7789_DMA_Abort(hdma, status);
+    return status;
+}
+
+/// Advance the DMA state machine, call from HAL_SPI_TxCpltCallback
+static inline void ST7789_DMA_TxCpltCallback(ST7789_DMA_HandleTypeDef* hdma, SPI_HandleTypeDef* hspi) {
+    if (hspi != hdma->hspi || hdma->stage == ST7789_DMA_STAGE_IDLE)
+        return;
+    ST7789_DMA_JobTypeDef* job = &hdma->queue[hdma->head];
+    if (hdma->stage != ST7789_DMA_STAGE_PIXELS || hdma->sent < job->size) {
+        if (hdma->stage != ST7789_DMA_STAGE_PIXELS)
+            hdma->stage++;
+        ST7789_DMA_StartStage(hdma);
+        return;
+    }
+
+    // Job done
+    ST7789_ChipSelect(false);
+    if (job->buffer >= 0)
+        hdma->buffer_jobs[job->buffer]--;
+    hdma->head = (hdma->head + 1) % ST7789_DMA_QUEUE_SIZE;
+    hdma->sent = 0;
+    if (hdma->head != hdma->tail) {
+        hdma->stage = ST7789_DMA_STAGE_CASET;
+        ST7789_DMA_StartStage(hdma);
+    } else {
+        hdma->stage = ST7789_DMA_STAGE_IDLE;
+    }
+}
+
+/// Whether any job is queued or on the wire
+static inline bool ST7789_DMA_Busy(ST7789_DMA_HandleTypeDef* hdma) {
+    return hdma->stage != ST7789_DMA_STAGE_IDLE;
+}
+
+/// Sleep until every queued job is sent or dropped
+/// Returns and clears the first failed start since the last call, HAL_OK if none
+static inline HAL_StatusTypeDef ST7789_DMA_Wait(ST7789_DMA_HandleTypeDef* hdma) {
+    __disable_irq();
+    while (ST7789_DMA_Busy(hdma)) {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    HAL_StatusTypeDef status = hdma->error;
+    hdma->error = HAL_OK;
+    __enable_irq();
+    return status;
+}
+
+/// Get the next line buffer to render into, waits until every job reading it is sent
+/// Buffers alternate, so one is rendered while the other is on the wire.
+/// A buffer may be submitted as any number of windows before it comes round again.
+static inline uint8_t* ST7789_DMA_AcquireBuffer(ST7789_DMA_HandleTypeDef* hdma) {
+    uint8_t index = hdma->next_buffer;
+    __disable_irq();
+    while (hdma->buffer_jobs[index]) {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+    hdma->next_buffer = index ^ 1;
+    return hdma->buffers[index];
+}
+
+/// Queue a write area and its pixels, returns without waiting for the transfer
+/// data must stay valid until sent. Line buffers from ST7789_DMA_AcquireBuffer
+/// are tracked per job and reused once every job reading them is sent.
+/// Returns the error if the transfer could not be started, the queue is then dropped.
+static inline HAL_StatusTypeDef ST7789_DMA_Submit(ST7789_DMA_HandleTypeDef* hdma, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                                                  const uint8_t* data, uint32_t size) {
+    if (!size)
+        return HAL_OK;
+    int8_t buffer = -1;
+    if (data >= hdma->buffers[0] && data < hdma->buffers[1] + ST7789_DMA_BUFFER_SIZE)
+        buffer = data < hdma->buffers[1] ? 0 : 1;
+
+    // The completion interrupt may free a slot or go idle between a check and
+    // the next step, so the queue is only touched with it masked
+    uint8_t next = (hdma->tail + 1) % ST7789_DMA_QUEUE_SIZE;
+    __disable_irq();
+    while (next == hdma->head) {
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    hdma->queue[hdma->tail] = (ST7789_DMA_JobTypeDef) {
+        .x = x, .y = y, .w = w, .h = h,
+        .data = data,
+        .size = size,
+        .buffer = buffer,
+    };
+    if (buffer >= 0)
+        hdma->buffer_jobs[buffer]++;
+    hdma->tail = next;
+    HAL_StatusTypeDef status = HAL_OK;
+    if (hdma->stage == ST7789_DMA_STAGE_IDLE) {
+        hdma->stage = ST7789_DMA_STAGE_CASET;
+        status = ST7789_DMA_StartStage(hdma);
+    }
+    __enable_irq();
+    return status;
 }
@@ -0,0 +1,326 @@
+#pragma once
+
+/*  =============================
+ *      ST7789 Color Conversion
+ *  =============================
+ *  Bulk packing of application colors into the wire format selected by
+ *  COLMOD. Sources are ARGB8888 words (0xAARRGGBB, alpha ignored) or RGB888
+ *  bytes in R, G, B order. Every kernel returns the number of bytes written.
+ *
+ *  Wire formats, all big-endian on the bus:
+ *  12 bit: 2 pixels in 3 bytes, RRRRGGGG BBBBRRRR GGGGBBBB
+ *  16 bit: RGB565, RRRRRGGG GGGBBBBB
+ *  18 bit: one byte per channel, upper 6 bits used
+ *
+ *  The portable kernels work a word at a time, which is what Cortex-M4
+ *  executes best, and are the MCU path. On the host an SSSE3 path handles
+ *  the bulk of ARGB conversions and the portable kernels handle the tail.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "st7789.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "ST7789 color conversion assumes a little-endian CPU"
+#endif
+
+/// Wire bytes for n pixels in the configured format
+/// In 12-bit mode an odd pixel at the end of a window takes 2 bytes.
+#if ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_12BIT
+#define ST7789_WIRE_BYTES(n) (((n) * 3 + 1) / 2)
+#elif ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_16BIT
+#define ST7789_WIRE_BYTES(n) ((n) * 2)
+#else
+#define ST7789_WIRE_BYTES(n) ((n) * 3)
+#endif
+
+static inline void ST7789_Store32(uint8_t* dst, uint32_t word) {
+    memcpy(dst, &word, 4);
+}
+
+static inline uint32_t ST7789_Load32(const uint8_t* src) {
+    uint32_t word;
+    memcpy(&word, src, 4);
+    return word;
+}
+
+/* 12-bit */
+
+static inline uint32_t ST7789_ARGBTo444(uint32_t argb) {
+    return (argb >> 12 & 0xF00) | (argb >> 8 & 0x0F0) | (argb >> 4 & 0x00F);
+}
+
+/// Pack ARGB8888 into 12-bit, word at a time
+/// Keep n even except for the last call of a window, pixel pairs share a byte.
+static inline uint32_t ST7789_PackARGB12_Word(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint8_t* out = dst;
+    uint32_t i = 0;
+    // 4 pixels, 6 bytes
+    for (; i + 4 <= n; i += 4, out += 6) {
+        uint32_t a = ST7789_ARGBTo444(src[i]) << 12 | ST7789_ARGBTo444(src[i + 1]);
+        uint32_t b = ST7789_ARGBTo444(src[i + 2]) << 12 | ST7789_ARGBTo444(src[i + 3]);
+        ST7789_Store32(out, (a >> 16) | (a & 0xFF00) | (a & 0xFF) << 16 | (b >> 16) << 24);
+        out[4] = b >> 8;
+        out[5] = b;
+    }
+    for (; i + 2 <= n; i += 2, out += 3) {
+        uint32_t a = ST7789_ARGBTo444(src[i]) << 12 | ST7789_ARGBTo444(src[i + 1]);
+        out[0] = a >> 16;
+        out[1] = a >> 8;
+        out[2] = a;
+    }
+    if (i < n) {
+        uint32_t a = ST7789_ARGBTo444(src[i]);
+        out[0] = a >> 4;
+        out[1] = a << 4;
+        out += 2;
+    }
+    return out - dst;
+}
+
+/// Pack ARGB8888 into 12-bit
+static inline uint32_t ST7789_PackARGB12(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint32_t i = 0;
+    uint8_t* out = dst;
+#if defined(__SSSE3__)
+    // 8 pixels, 12 bytes: nibbles gathered per pixel, then pairs joined in 64-bit lanes
+    const __m128i nibble_r = _mm_set1_epi32(0xF00), nibble_g = _mm_set1_epi32(0x0F0), nibble_b = _mm_set1_epi32(0x00F);
+    const __m128i lo = _mm_setr_epi8(2, 1, 0, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 1, 0, 10, 9, 8, -1, -1, -1, -1);
+    for (; i + 8 <= n; i += 8, out += 12) {
+        __m128i p[2];
+        for (int k = 0; k < 2; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i + 4 * k));
+            __m128i c = _mm_or_si128(_mm_or_si128(
+                _mm_and_si128(_mm_srli_epi32(v, 12), nibble_r),
+                _mm_and_si128(_mm_srli_epi32(v, 8), nibble_g)),
+                _mm_and_si128(_mm_srli_epi32(v, 4), nibble_b));
+            // Even pixel above odd pixel in the low 24 bits of each 64-bit lane
+            p[k] = _mm_or_si128(_mm_slli_epi64(c, 12), _mm_srli_epi64(c, 32));
+        }
+        __m128i bytes = _mm_or_si128(_mm_shuffle_epi8(p[0], lo), _mm_shuffle_epi8(p[1], hi));
+        _mm_storel_epi64((__m128i*)out, bytes);
+        ST7789_Store32(out + 8, (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(bytes, 8)));
+    }
+#endif
+    return (out - dst) + ST7789_PackARGB12_Word(out, src + i, n - i);
+}
+
+/// Pack RGB888 bytes into 12-bit, word at a time
+/// Each wire byte takes the high nibbles of two source bytes, so pixel pairs map 6 bytes to 3.
+static inline uint32_t ST7789_PackRGB12_Word(uint8_t* dst, const uint8_t* src, uint32_t n) {
+    uint8_t* out = dst;
+    uint32_t i = 0;
+    // 4 pixels, 3 words in, 6 bytes out
+    for (; i + 4 <= n; i += 4, src += 12, out += 6) {
+        uint32_t h[3];
+        for (int k = 0; k < 3; k++) {
+            uint32_t w = ST7789_Load32(src + 4 * k);
+            w = (w & 0x00F000F0) | (w >> 12 & 0x000F000F);
+            h[k] = (w & 0xFF) | (w >> 8 & 0xFF00);
+        }
+        ST7789_Store32(out, h[0] | h[1] << 16);
+        out[4] = h[2];
+        out[5] = h[2] >> 8;
+    }
+    for (; i + 2 <= n; i += 2, src += 6, out += 3) {
+        out[0] = (src[0] & 0xF0) | src[1] >> 4;
+        out[1] = (src[2] & 0xF0) | src[3] >> 4;
+        out[2] = (src[4] & 0xF0) | src[5] >> 4;
+    }
+    if (i < n) {
+        out[0] = (src[0] & 0xF0) | src[1] >> 4;
+        out[1] = src[2] & 0xF0;
+        out += 2;
+    }
+    return out - dst;
+}
+
+/// Pack RGB888 bytes into 12-bit
+static inline uint32_t ST7789_PackRGB12(uint8_t* dst, const uint8_t* src, uint32_t n) {
+    uint32_t i = 0;
+    uint8_t* out = dst;
+#if defined(__SSSE3__)
+    // 16 pixels, 48 bytes in, 24 out: byte pairs joined in 16-bit lanes, then narrowed
+    const __m128i even = _mm_set1_epi16(0x00F0);
+    for (; i + 16 <= n; i += 16, out += 24) {
+        __m128i p[3];
+        for (int k = 0; k < 3; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + 3 * i + 16 * k));
+            p[k] = _mm_or_si128(_mm_and_si128(v, even), _mm_srli_epi16(v, 12));
+        }
+        _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(p[0], p[1]));
+        _mm_storel_epi64((__m128i*)(out + 16), _mm_packus_epi16(p[2], p[2]));
+    }
+#endif
+    return (out - dst) + ST7789_PackRGB12_Word(out, src + 3 * i, n - i);
+}
+
+/* 16-bit */
+
+static inline uint32_t ST7789_ARGBTo565(uint32_t argb) {
+    return (argb >> 8 & 0xF800) | (argb >> 5 & 0x07E0) | (argb >> 3 & 0x001F);
+}
+
+/// Pack ARGB8888 into 16-bit, word at a time
+static inline uint32_t ST7789_PackARGB16_Word(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        // Both pixels in one word, then swap bytes within each half
+        uint32_t v = ST7789_ARGBTo565(src[i]) | ST7789_ARGBTo565(src[i + 1]) << 16;
+        ST7789_Store32(dst + 2 * i, (v >> 8 & 0x00FF00FF) | (v << 8 & 0xFF00FF00));
+    }
+    if (i < n) {
+        uint32_t v = ST7789_ARGBTo565(src[i]);
+        dst[2 * i] = v >> 8;
+        dst[2 * i + 1] = v;
+    }
+    return 2 * n;
+}
+
+/// Pack ARGB8888 into 16-bit
+static inline uint32_t ST7789_PackARGB16(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint32_t i = 0;
+#if defined(__SSSE3__)
+    // 8 pixels, 16 bytes
+    const __m128i mask_r = _mm_set1_epi32(0xF800), mask_g = _mm_set1_epi32(0x07E0), mask_b = _mm_set1_epi32(0x001F);
+    const __m128i lo = _mm_setr_epi8(1, 0, 5, 4, 9, 8, 13, 12, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 1, 0, 5, 4, 9, 8, 13, 12);
+    for (; i + 8 <= n; i += 8) {
+        __m128i p[2];
+        for (int k = 0; k < 2; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i + 4 * k));
+            p[k] = _mm_or_si128(_mm_or_si128(
+                _mm_and_si128(_mm_srli_epi32(v, 8), mask_r),
+                _mm_and_si128(_mm_srli_epi32(v, 5), mask_g)),
+                _mm_and_si128(_mm_srli_epi32(v, 3), mask_b));
+        }
+        _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_or_si128(_mm_shuffle_epi8(p[0], lo), _mm_shuffle_epi8(p[1], hi)));
+    }
+#endif
+    return 2 * i + ST7789_PackARGB16_Word(dst + 2 * i, src + i, n - i);
+}
+
+/// RGB565 of a pixel loaded as a word, R in the low byte
+static inline uint32_t ST7789_RGBTo565(uint32_t rgb) {
+    return (rgb << 8 & 0xF800) | (rgb >> 5 & 0x07E0) | (rgb >> 19 & 0x001F);
+}
+
+/// Pack RGB888 bytes into 16-bit, word at a time
+static inline uint32_t ST7789_PackRGB16_Word(uint8_t* dst, const uint8_t* src, uint32_t n) {
+    uint32_t i = 0;
+    // 4 pixels, 3 words: R0G0B0R1 G1B1R2G2 B2R3G3B3
+    for (; i + 4 <= n; i += 4, src += 12) {
+        uint32_t w0 = ST7789_Load32(src), w1 = ST7789_Load32(src + 4), w2 = ST7789_Load32(src + 8);
+        uint32_t a = ST7789_RGBTo565(w0) | ST7789_RGBTo565(w0 >> 24 | w1 << 8) << 16;
+        uint32_t b = ST7789_RGBTo565(w1 >> 16 | w2 << 16) | ST7789_RGBTo565(w2 >> 8) << 16;
+        ST7789_Store32(dst + 2 * i, (a >> 8 & 0x00FF00FF) | (a << 8 & 0xFF00FF00));
+        ST7789_Store32(dst + 2 * i + 4, (b >> 8 & 0x00FF00FF) | (b << 8 & 0xFF00FF00));
+    }
+    for (; i < n; i++, src += 3) {
+        dst[2 * i] = (src[0] & 0xF8) | src[1] >> 5;
+        dst[2 * i + 1] = (src[1] << 3 & 0xE0) | src[2] >> 3;
+    }
+    return 2 * n;
+}
+
+/// Pack RGB888 bytes into 16-bit
+static inline uint32_t ST7789_PackRGB16(uint8_t* dst, const uint8_t* src, uint32_t n) {
+    uint32_t i = 0;
+#if defined(__SSSE3__)
+    // 8 pixels, 16 bytes: spread to ARGB lanes, then as ST7789_PackARGB16
+    // Each load reads 16 bytes for 12, so the loop keeps 2 pixels of room
+    const __m128i spread = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i mask_r = _mm_set1_epi32(0xF800), mask_g = _mm_set1_epi32(0x07E0), mask_b = _mm_set1_epi32(0x001F);
+    const __m128i lo = _mm_setr_epi8(1, 0, 5, 4, 9, 8, 13, 12, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 1, 0, 5, 4, 9, 8, 13, 12);
+    for (; i + 10 <= n; i += 8) {
+        __m128i p[2];
+        for (int k = 0; k < 2; k++) {
+            __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 3 * i + 12 * k)), spread);
+            p[k] = _mm_or_si128(_mm_or_si128(
+                _mm_and_si128(_mm_srli_epi32(v, 8), mask_r),
+                _mm_and_si128(_mm_srli_epi32(v, 5), mask_g)),
+                _mm_and_si128(_mm_srli_epi32(v, 3), mask_b));
+        }
+        _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_or_si128(_mm_shuffle_epi8(p[0], lo), _mm_shuffle_epi8(p[1], hi)));
+    }
+#endif
+    return 2 * i + ST7789_PackRGB16_Word(dst + 2 * i, src + 3 * i, n - i);
+}
+
+/* 18-bit */
+
+/// Pack ARGB8888 into 18-bit, word at a time
+static inline uint32_t ST7789_PackARGB18_Word(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint32_t i = 0;
+    // 4 pixels, 3 words: R0G0B0R1 G1B1R2G2 B2R3G3B3
+    for (; i + 4 <= n; i += 4) {
+        uint32_t p0 = src[i] & 0xFCFCFC, p1 = src[i + 1] & 0xFCFCFC;
+        uint32_t p2 = src[i + 2] & 0xFCFCFC, p3 = src[i + 3] & 0xFCFCFC;
+        uint8_t* out = dst + 3 * i;
+        ST7789_Store32(out, (p0 >> 16) | (p0 & 0xFF00) | (p0 & 0xFF) << 16 | (p1 >> 16) << 24);
+        ST7789_Store32(out + 4, (p1 >> 8 & 0xFF) | (p1 & 0xFF) << 8 | (p2 >> 16) << 16 | (p2 >> 8 & 0xFF) << 24);
+        ST7789_Store32(out + 8, (p2 & 0xFF) | (p3 >> 16) << 8 | (p3 & 0xFF00) << 8 | (p3 & 0xFF) << 24);
+    }
+    for (; i < n; i++) {
+        dst[3 * i] = src[i] >> 16 & 0xFC;
+        dst[3 * i + 1] = src[i] >> 8 & 0xFC;
+        dst[3 * i + 2] = src[i] & 0xFC;
+    }
+    return 3 * n;
+}
+
+/// Pack ARGB8888 into 18-bit
+static inline uint32_t ST7789_PackARGB18(uint8_t* dst, const uint32_t* src, uint32_t n) {
+    uint32_t i = 0;
+#if defined(__SSSE3__)
+    // 4 pixels, 12 bytes, stored as 16 so the loop keeps 2 pixels of room
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i mask = _mm_set1_epi8((char)0xFC);
+    for (; i + 6 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + 3 * i), _mm_and_si128(_mm_shuffle_epi8(v, order), mask));
+    }
+#endif
+    return 3 * i + ST7789_PackARGB18_Word(dst + 3 * i, src + i, n - i);
+}
+
+/// Pack RGB888 bytes into 18-bit, the layout is the same so only low bits are cleared
+static inline uint32_t ST7789_PackRGB18(uint8_t* dst, const uint8_t* src, uint32_t n) {
+    uint32_t size = 3 * n, i = 0;
+    for (; i + 4 <= size; i += 4)
+        ST7789_Store32(dst + i, ST7789_Load32(src + i) & 0xFCFCFCFC);
+    for (; i < size; i++)
+        dst[i] = src[i] & 0xFC;
+    return size;
+}
+
+/* Configured format */
+
+/// Pack ARGB8888 into the configured wire format
+static inline uint32_t ST7789_PackARGB(uint8_t* dst, const uint32_t* src, uint32_t n) {
+#if ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_12BIT
+    return ST7789_PackARGB12(dst, src, n);
+#elif ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_16BIT
+    return ST7789_PackARGB16(dst, src, n);
+#else
+    return ST7789_PackARGB18(dst, src, n);
+#endif
+}
+
+/// Pack RGB888 bytes into the configured wire format
+static inline uint32_t ST7789_PackRGB(uint8_t* dst, const uint8_t* src, uint32_t n) {
+#if ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_12BIT
+    return ST7789_PackRGB12(dst, src, n);
+#elif ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_16BIT
+    return ST7789_PackRGB16(dst, src, n);
+#else
+    return ST7789_PackRGB18(dst, src, n);
+#endif
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+/*  =============================
+ *      ST7789 Framebuffer Configuration
+ *  ============================= */
+
+/* Dirty Rectangles */
+// Rectangles tracked between flushes, the cheapest pair is merged when full
+#define ST7789_FB_MAX_DIRTY (8)
+// Cost of opening a window, in pixel bytes: 11 command bytes in 5 transactions
+// plus the gaps between them. Two rectangles are merged when sending their
+// union costs no more than sending both.
+#define ST7789_FB_SETUP_COST (64)
+
+/* Flush Setting */
+// Full mode copies strided rows into this buffer to send several rows per transaction
+#define ST7789_FB_SCRATCH_SIZE (1024)
+
+/*  =============================
+ *      ST7789 Framebuffer Implementation
+ *  =============================
+ *  Full mode keeps the whole screen in wire format (97200 bytes at 18-bit,
+ *  64800 bytes at 16-bit) and sends only dirty rectangles.
+ *  Tiled mode keeps no pixels: a render callback fills a small tile buffer
+ *  with any strip of a dirty rectangle, and the strips of one rectangle are
+ *  streamed into a single window.
+ *  Dirty rectangles never overlap, so no pixel is sent twice per flush.
+ *  Only 16-bit and 18-bit formats are supported: 12-bit packs two pixels
+ *  into three bytes, so rectangles would need even x and width.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "st7789.h"
+
+#if ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_18BIT
+#define ST7789_FB_BYTES_PER_PIXEL (3)
+#elif ST7789_PIXEL_FORMAT == ST7789_PIXEL_FORMAT_16BIT
+#define ST7789_FB_BYTES_PER_PIXEL (2)
+#else
+#error "ST7789 framebuffer requires 16-bit or 18-bit pixel format"
+#endif
+
+#define ST7789_FB_WIDTH (ST7789_WIDTH)
+#define ST7789_FB_HEIGHT (ST7789_HEIGHT)
+#define ST7789_FB_SIZE (ST7789_FB_WIDTH * ST7789_FB_HEIGHT * ST7789_FB_BYTES_PER_PIXEL)
+
+/// Tiled mode callback: write the pixels of rect, row by row in wire format, to out
+typedef void (*ST7789_FB_RenderTypeDef)(void* context, ST7789_RectTypeDef rect, uint8_t* out);
+
+typedef struct {
+    SPI_HandleTypeDef* hspi;
+    uint8_t* pixels;                // Full mode, ST7789_FB_SIZE bytes, NULL in tiled mode
+    ST7789_FB_RenderTypeDef render; // Tiled mode
+    void* context;
+    uint8_t* tile;
+    uint32_t tile_size;
+    ST7789_RectTypeDef dirty[ST7789_FB_MAX_DIRTY];
+    uint8_t dirty_count;
+} ST7789_FB_HandleTypeDef;
+
+/// Initialize a full framebuffer, pixels must hold ST7789_FB_SIZE bytes
+static inline void ST7789_FB_Init(ST7789_FB_HandleTypeDef* hfb, SPI_HandleTypeDef* hspi, uint8_t* pixels) {
+    memset(hfb, 0, sizeof(*hfb));
+    hfb->hspi = hspi;
+    hfb->pixels = pixels;
+}
+
+/// Initialize a tiled framebuffer, tile must hold at least one screen row
+/// Returns HAL_ERROR and leaves nothing to flush when the tile is too small
+static inline HAL_StatusTypeDef ST7789_FB_InitTiled(ST7789_FB_HandleTypeDef* hfb, SPI_HandleTypeDef* hspi,
+                                                    uint8_t* tile, uint32_t tile_size,
+                                                    ST7789_FB_RenderTypeDef render, void* context) {
+    memset(hfb, 0, sizeof(*hfb));
+    if (tile_size < ST7789_FB_WIDTH * ST7789_FB_BYTES_PER_PIXEL)
+        return HAL_ERROR;
+    hfb->hspi = hspi;
+    hfb->tile = tile;
+    hfb->tile_size = tile_size;
+    hfb->render = render;
+    hfb->context = context;
+    return HAL_OK;
+}
+
+/// Pixel bytes at (x, y) in full mode, rows are ST7789_FB_WIDTH pixels apart
+static inline uint8_t* ST7789_FB_Pixel(ST7789_FB_HandleTypeDef* hfb, uint16_t x, uint16_t y) {
+    return hfb->pixels + ((uint32_t)y * ST7789_FB_WIDTH + x) * ST7789_FB_BYTES_PER_PIXEL;
+}
+
+static inline uint32_t ST7789_FB_RectCost(ST7789_RectTypeDef r) {
+    return ST7789_FB_SETUP_COST + (uint32_t)r.w * r.h * ST7789_FB_BYTES_PER_PIXEL;
+}
+
+static inline ST7789_RectTypeDef ST7789_FB_RectUnion(ST7789_RectTypeDef a, ST7789_RectTypeDef b) {
+    uint16_t x0 = a.x < b.x ? a.x : b.x;
+    uint16_t y0 = a.y < b.y ? a.y : b.y;
+    uint16_t x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    uint16_t y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+    return (ST7789_RectTypeDef) {x0, y0, x1 - x0, y1 - y0};
+}
+
+static inline bool ST7789_FB_RectOverlap(ST7789_RectTypeDef a, ST7789_RectTypeDef b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+static inline bool ST7789_FB_RectContains(ST7789_RectTypeDef outer, ST7789_RectTypeDef inner) {
+    return inner.x >= outer.x && inner.x + inner.w <= outer.x + outer.w
+        && inner.y >= outer.y && inner.y + inner.h <= outer.y + outer.h;
+}
+
+/// Whether one window over both rectangles is no more expensive than two
+static inline bool ST7789_FB_MergeCheaper(ST7789_RectTypeDef a, ST7789_RectTypeDef b) {
+    return ST7789_FB_RectCost(ST7789_FB_RectUnion(a, b)) <= ST7789_FB_RectCost(a) + ST7789_FB_RectCost(b);
+}
+
+/// Whether r overlaps a tracked rectangle other than the one at skip
+static inline bool ST7789_FB_OverlapsDirty(ST7789_FB_HandleTypeDef* hfb, ST7789_RectTypeDef r, uint8_t skip) {
+    for (uint8_t i = 0; i < hfb->dirty_count; i++)
+        if (i != skip && ST7789_FB_RectOverlap(r, hfb->dirty[i]))
+            return true;
+    return false;
+}
+
+static inline void ST7789_FB_RemoveDirty(ST7789_FB_HandleTypeDef* hfb, uint8_t i) {
+    hfb->dirty[i] = hfb->dirty[--hfb->dirty_count];
+}
+
+/// Merge the pair whose union adds the least cost, then absorb whatever the union overlaps
+static inline void ST7789_FB_ForceMerge(ST7789_FB_HandleTypeDef* hfb) {
+    uint8_t best_i = 0, best_j = 1;
+    int32_t best = INT32_MAX;
+    for (uint8_t i = 0; i < hfb->dirty_count; i++) {
+        for (uint8_t j = i + 1; j < hfb->dirty_count; j++) {
+            int32_t extra = (int32_t)ST7789_FB_RectCost(ST7789_FB_RectUnion(hfb->dirty[i], hfb->dirty[j]))
+                - (int32_t)ST7789_FB_RectCost(hfb->dirty[i]) - (int32_t)ST7789_FB_RectCost(hfb->dirty[j]);
+            if (extra < best) {
+                best = extra;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+    ST7789_RectTypeDef u = ST7789_FB_RectUnion(hfb->dirty[best_i], hfb->dirty[best_j]);
+    ST7789_FB_RemoveDirty(hfb, best_j);     // best_j > best_i, best_i stays in place
+    ST7789_FB_RemoveDirty(hfb, best_i);
+    for (uint8_t k = 0; k < hfb->dirty_count; ) {
+        if (ST7789_FB_RectOverlap(u, hfb->dirty[k])) {
+            u = ST7789_FB_RectUnion(u, hfb->dirty[k]);
+            ST7789_FB_RemoveDirty(hfb, k);
+            k = 0;
+        } else {
+            k++;
+        }
+    }
+    hfb->dirty[hfb->dirty_count++] = u;
+}
+
+/// Add a clipped rectangle, keeping the list free of overlaps
+static inline void ST7789_FB_AddDirty(ST7789_FB_HandleTypeDef* hfb, ST7789_RectTypeDef r) {
+    for (uint8_t i = 0; i < hfb->dirty_count; i++) {
+        ST7789_RectTypeDef d = hfb->dirty[i];
+        if (ST7789_FB_RectContains(d, r))
+            return;
+        // A union reaching a third rectangle would be split again, possibly
+        // back into the pieces it came from
+        ST7789_RectTypeDef u = ST7789_FB_RectUnion(d, r);
+        if (ST7789_FB_MergeCheaper(d, r) && !ST7789_FB_OverlapsDirty(hfb, u, i)) {
+            ST7789_FB_RemoveDirty(hfb, i);
+            ST7789_FB_AddDirty(hfb, u);
+            return;
+        }
+        if (!ST7789_FB_RectOverlap(d, r))
+            continue;
+
+        // Keep only the parts of r outside d: full width bands above and
+        // below it, then the pieces left and right of it
+        uint16_t y0 = d.y > r.y ? d.y : r.y;
+        uint16_t y1 = d.y + d.h < r.y + r.h ? d.y + d.h : r.y + r.h;
+        if (r.y < y0)
+            ST7789_FB_AddDirty(hfb, (ST7789_RectTypeDef) {r.x, r.y, r.w, y0 - r.y});
+        if (y1 < r.y + r.h)
+            ST7789_FB_AddDirty(hfb, (ST7789_RectTypeDef) {r.x, y1, r.w, r.y + r.h - y1});
+        if (r.x < d.x)
+            ST7789_FB_AddDirty(hfb, (ST7789_RectTypeDef) {r.x, y0, d.x - r.x, y1 - y0});
+        if (d.x + d.w < r.x + r.w)
+            ST7789_FB_AddDirty(hfb, (ST7789_RectTypeDef) {d.x + d.w, y0, r.x + r.w - d.x - d.w, y1 - y0});
+        return;
+    }
+
+    // No room: merging a pair may grow it over r, so start over
+    if (hfb->dirty_count == ST7789_FB_MAX_DIRTY) {
+        ST7789_FB_ForceMerge(hfb);
+        ST7789_FB_AddDirty(hfb, r);
+        return;
+    }
+    hfb->dirty[hfb->dirty_count++] = r;
+}
+
+/// Mark a region as changed, clipped to the screen
+/// Merged into a tracked rectangle when one window is cheaper, otherwise
+/// split around the tracked ones it overlaps.
+static inline void ST7789_FB_Invalidate(ST7789_FB_HandleTypeDef* hfb, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+    if (x >= ST7789_FB_WIDTH || y >= ST7789_FB_HEIGHT || !w || !h)
+        return;
+    if (w > ST7789_FB_WIDTH - x)
+        w = ST7789_FB_WIDTH - x;
+    if (h > ST7789_FB_HEIGHT - y)
+        h = ST7789_FB_HEIGHT - y;
+    ST7789_FB_AddDirty(hfb, (ST7789_RectTypeDef) {x, y, w, h});
+}
+
+/// Mark the whole screen as changed
+static inline void ST7789_FB_InvalidateAll(ST7789_FB_HandleTypeDef* hfb) {
+    hfb->dirty_count = 0;
+    ST7789_FB_Invalidate(hfb, 0, 0, ST7789_FB_WIDTH, ST7789_FB_HEIGHT);
+}
+
+/// Fill a rectangle with one wire format color in full mode and mark it changed
+static inline void ST7789_FB_FillRect(ST7789_FB_HandleTypeDef* hfb, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                                      const uint8_t color[ST7789_FB_BYTES_PER_PIXEL]) {
+    if (x >= ST7789_FB_WIDTH || y >= ST7789_FB_HEIGHT)
+        return;
+    if (w > ST7789_FB_WIDTH - x)
+        w = ST7789_FB_WIDTH - x;
+    if (h > ST7789_FB_HEIGHT - y)
+        h = ST7789_FB_HEIGHT - y;
+    for (uint16_t row = 0; row < h; row++) {
+        uint8_t* p = ST7789_FB_Pixel(hfb, x, y + row);
+        for (uint16_t col = 0; col < w; col++, p += ST7789_FB_BYTES_PER_PIXEL)
+            memcpy(p, color, ST7789_FB_BYTES_PER_PIXEL);
+    }
+    ST7789_FB_Invalidate(hfb, x, y, w, h);
+}
+
+/// Send one dirty rectangle from the full framebuffer
+static inline void ST7789_FB_FlushRect(ST7789_FB_HandleTypeDef* hfb, ST7789_RectTypeDef r) {
+    static uint8_t scratch[ST7789_FB_SCRATCH_SIZE];
+    const uint32_t row_size = (uint32_t)r.w * ST7789_FB_BYTES_PER_PIXEL;
+    ST7789_SetWriteArea(hfb->hspi, r.x, r.y, r.w, r.h);
+
+    // Full width rows are contiguous
+    if (r.w == ST7789_FB_WIDTH) {
+        const uint8_t* p = ST7789_FB_Pixel(hfb, 0, r.y);
+        uint32_t size = row_size * r.h;
+        while (size) {
+            uint16_t chunk = size > 0xFFFF ? 0xFFFF - 0xFFFF % ST7789_FB_BYTES_PER_PIXEL : size;
+            ST7789_Transmit(hfb->hspi, p, chunk, ST7789_SPI_TIMEOUT);
+            p += chunk;
+            size -= chunk;
+        }
+        return;
+    }
+
+    // Gather as many rows as fit in the scratch buffer per transaction
+    uint16_t rows = row_size <= sizeof(scratch) ? sizeof(scratch) / row_size : 0;
+    if (!rows) {
+        for (uint16_t row = 0; row < r.h; row++)
+            ST7789_Transmit(hfb->hspi, ST7789_FB_Pixel(hfb, r.x, r.y + row), row_size, ST7789_SPI_TIMEOUT);
+        return;
+    }
+    for (uint16_t row = 0; row < r.h; ) {
+        uint16_t n = r.h - row < rows ? r.h - row : rows;
+        for (uint16_t i = 0; i < n; i++)
+            memcpy(scratch + i * row_size, ST7789_FB_Pixel(hfb, r.x, r.y + row + i), row_size);
+        ST7789_Transmit(hfb->hspi, scratch, n * row_size, ST7789_SPI_TIMEOUT);
+        row += n;
+    }
+}
+
+/// Render and send one dirty rectangle strip by strip in tiled mode
+static inline void ST7789_FB_FlushRectTiled(ST7789_FB_HandleTypeDef* hfb, ST7789_RectTypeDef r) {
+    const uint32_t row_size = (uint32_t)r.w * ST7789_FB_BYTES_PER_PIXEL;
+    uint32_t rows = hfb->tile_size / row_size;
+    if (rows > 0xFFFF / row_size)
+        rows = 0xFFFF / row_size;
+    // Not even one row fits, see ST7789_FB_InitTiled
+    if (!rows)
+        return;
+    ST7789_SetWriteArea(hfb->hspi, r.x, r.y, r.w, r.h);
+    for (uint16_t row = 0; row < r.h; ) {
+        uint16_t n = r.h - row < rows ? r.h - row : rows;
+        hfb->render(hfb->context, (ST7789_RectTypeDef) {r.x, r.y + row, r.w, n}, hfb->tile);
+        ST7789_Transmit(hfb->hspi, hfb->tile, n * row_size, ST7789_SPI_TIMEOUT);
+        row += n;
+    }
+}
+
+/// Send every dirty rectangle and clear the list, returns the number of windows sent
+static inline uint8_t ST7789_FB_Flush(ST7789_FB_HandleTypeDef* hfb) {
+    uint8_t count = hfb->dirty_count;
+    for (uint8_t i = 0; i < count; i++) {
+        if (hfb->pixels)
+            ST7789_FB_FlushRect(hfb, hfb->dirty[i]);
+        else
+            ST7789_FB_FlushRectTiled(hfb, hfb->dirty[i]);
+    }
+    hfb->dirty_count = 0;
+    return count;
+}
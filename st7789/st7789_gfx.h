@@ -0,0 +1,202 @@
+#pragma once
+
+/*  =============================
+ *      ST7789 Graphics Configuration
+ *  ============================= */
+
+/* Buffer Setting */
+// Pixels staged per transaction, one screen row by default
+// Must be even so 12-bit pixel pairs never straddle two transactions
+#define ST7789_GFX_BUFFER_PIXELS (ST7789_MEM_Y_SIZE)
+
+/*  =============================
+ *      ST7789 Graphics Implementation
+ *  =============================
+ *  Primitives drawn straight to the panel, one window per call.
+ *  Colors are ARGB8888 (alpha ignored) and packed with st7789_color.h.
+ *  Solid fills pack one buffer of a single color and send it repeatedly, so
+ *  memory does not grow with the rectangle. Blits and text stage pixels in a
+ *  small buffer that is packed and sent each time it fills.
+ */
+
+#include <stdint.h>
+#include "st7789.h"
+#include "st7789_color.h"
+
+#if ST7789_GFX_BUFFER_PIXELS % 2
+#error "ST7789_GFX_BUFFER_PIXELS must be even"
+#endif
+
+#define ST7789_FONT_WIDTH (5)
+#define ST7789_FONT_HEIGHT (7)
+// Glyph cell including one column and one row of spacing
+#define ST7789_FONT_CELL_WIDTH (ST7789_FONT_WIDTH + 1)
+#define ST7789_FONT_CELL_HEIGHT (ST7789_FONT_HEIGHT + 1)
+
+/// 5x7 font for ASCII 0x20..0x7E, one byte per column, bit 0 at the top
+const static uint8_t ST7789_FONT_5X7[95][ST7789_FONT_WIDTH] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00}, // ' ' ! "
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, // # $ %
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00}, // & ' (
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x08, 0x2A, 0x1C, 0x2A, 0x08}, {0x08, 0x08, 0x3E, 0x08, 0x08}, // ) * +
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00}, // , - .
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, // / 0 1
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10}, // 2 3 4
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03}, // 5 6 7
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00}, // 8 9 :
+    {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, // ; < =
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E}, // > ? @
+    {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22}, // A B C
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x01, 0x01}, // D E F
+    {0x3E, 0x41, 0x41, 0x51, 0x32}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, // G H I
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40}, // J K L
+    {0x7F, 0x02, 0x04, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E}, // M N O
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, // P Q R
+    {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, // S T U
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F}, {0x63, 0x14, 0x08, 0x14, 0x63}, // V W X
+    {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00}, // Y Z [
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04}, // \ ] ^
+    {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78}, // _ ` a
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, {0x38, 0x44, 0x44, 0x48, 0x7F}, // b c d
+    {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x08, 0x14, 0x54, 0x54, 0x3C}, // e f g
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00}, // h i j
+    {0x00, 0x7F, 0x10, 0x28, 0x44}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78}, // k l m
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0x7C, 0x14, 0x14, 0x14, 0x08}, // n o p
+    {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20}, // q r s
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C}, // t u v
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C}, // w x y
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x7F, 0x00, 0x00}, // z { |
+    {0x00, 0x41, 0x36, 0x08, 0x00}, {0x02, 0x01, 0x02, 0x04, 0x02},                                 // } ~
+};
+
+/// Staged pixels for one window, sent every ST7789_GFX_BUFFER_PIXELS pixels
+typedef struct {
+    SPI_HandleTypeDef* hspi;
+    uint32_t count;
+    uint32_t pixels[ST7789_GFX_BUFFER_PIXELS];
+    uint8_t wire[ST7789_WIRE_BYTES(ST7789_GFX_BUFFER_PIXELS)];
+} ST7789_GFX_StreamTypeDef;
+
+static inline void ST7789_GFX_Flush(ST7789_GFX_StreamTypeDef* stream) {
+    if (!stream->count)
+        return;
+    uint32_t size = ST7789_PackARGB(stream->wire, stream->pixels, stream->count);
+    ST7789_Transmit(stream->hspi, stream->wire, size, ST7789_SPI_TIMEOUT);
+    stream->count = 0;
+}
+
+static inline void ST7789_GFX_Put(ST7789_GFX_StreamTypeDef* stream, uint32_t argb) {
+    stream->pixels[stream->count++] = argb;
+    if (stream->count == ST7789_GFX_BUFFER_PIXELS)
+        ST7789_GFX_Flush(stream);
+}
+
+/// Shared stream, primitives are not reentrant
+static inline ST7789_GFX_StreamTypeDef* ST7789_GFX_Begin(SPI_HandleTypeDef* hspi, ST7789_RectTypeDef r) {
+    static ST7789_GFX_StreamTypeDef stream;
+    stream.hspi = hspi;
+    stream.count = 0;
+    ST7789_SetWriteArea(hspi, r.x, r.y, r.w, r.h);
+    return &stream;
+}
+
+/// Intersect a rectangle at a signed position with a clip rectangle and the screen
+/// Returns false if nothing is visible.
+static inline bool ST7789_GFX_Clip(int32_t x, int32_t y, int32_t w, int32_t h, ST7789_RectTypeDef clip, ST7789_RectTypeDef* out) {
+    int32_t x0 = x > clip.x ? x : clip.x;
+    int32_t y0 = y > clip.y ? y : clip.y;
+    int32_t x1 = x + w < clip.x + clip.w ? x + w : clip.x + clip.w;
+    int32_t y1 = y + h < clip.y + clip.h ? y + h : clip.y + clip.h;
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 > ST7789_WIDTH)
+        x1 = ST7789_WIDTH;
+    if (y1 > ST7789_HEIGHT)
+        y1 = ST7789_HEIGHT;
+    if (x0 >= x1 || y0 >= y1)
+        return false;
+    *out = (ST7789_RectTypeDef) {x0, y0, x1 - x0, y1 - y0};
+    return true;
+}
+
+#define ST7789_GFX_SCREEN ((ST7789_RectTypeDef) {0, 0, ST7789_WIDTH, ST7789_HEIGHT})
+
+/// Fill a rectangle with one color, clipped to the screen
+/// A single-color buffer is packed once per color and sent as many times as needed.
+static inline void ST7789_FillRect(SPI_HandleTypeDef* hspi, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint32_t argb) {
+    // Whole 12-bit pixel pairs, so every chunk starts on a pair
+    static uint8_t pattern[ST7789_WIRE_BYTES(ST7789_GFX_BUFFER_PIXELS)];
+    static uint32_t pattern_color;
+    static bool pattern_valid = false;
+    ST7789_RectTypeDef r;
+    if (!ST7789_GFX_Clip(x, y, w, h, ST7789_GFX_SCREEN, &r))
+        return;
+
+    argb &= 0xFFFFFF;
+    if (!pattern_valid || pattern_color != argb) {
+        const uint32_t pair[2] = {argb, argb};
+        uint32_t period = ST7789_PackARGB(pattern, pair, 2);
+        for (uint32_t i = period; i < sizeof(pattern); i++)
+            pattern[i] = pattern[i - period];
+        pattern_color = argb;
+        pattern_valid = true;
+    }
+
+    ST7789_SetWriteArea(hspi, r.x, r.y, r.w, r.h);
+    uint32_t size = ST7789_WIRE_BYTES((uint32_t)r.w * r.h);
+    while (size) {
+        uint16_t chunk = size < sizeof(pattern) ? size : sizeof(pattern);
+        ST7789_Transmit(hspi, pattern, chunk, ST7789_SPI_TIMEOUT);
+        size -= chunk;
+    }
+}
+
+/// Draw a horizontal line of w pixels
+static inline void ST7789_DrawHLine(SPI_HandleTypeDef* hspi, uint16_t x, uint16_t y, uint16_t w, uint32_t argb) {
+    ST7789_FillRect(hspi, x, y, w, 1, argb);
+}
+
+/// Draw a vertical line of h pixels
+static inline void ST7789_DrawVLine(SPI_HandleTypeDef* hspi, uint16_t x, uint16_t y, uint16_t h, uint32_t argb) {
+    ST7789_FillRect(hspi, x, y, 1, h, argb);
+}
+
+/// Copy a w x h ARGB sprite to (x, y), which may be partly off screen
+/// Only the part inside clip is drawn, in one window.
+static inline void ST7789_Blit(SPI_HandleTypeDef* hspi, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                               const uint32_t* pixels, ST7789_RectTypeDef clip) {
+    ST7789_RectTypeDef r;
+    if (!ST7789_GFX_Clip(x, y, w, h, clip, &r))
+        return;
+    ST7789_GFX_StreamTypeDef* stream = ST7789_GFX_Begin(hspi, r);
+    for (uint16_t row = 0; row < r.h; row++) {
+        const uint32_t* src = pixels + (uint32_t)(r.y - y + row) * w + (r.x - x);
+        for (uint16_t col = 0; col < r.w; col++)
+            ST7789_GFX_Put(stream, src[col]);
+    }
+    ST7789_GFX_Flush(stream);
+}
+
+/// Draw a string in the 5x7 font with its cell background, in one window
+/// Characters outside ASCII 0x20..0x7E are drawn as '?'. Clipped to the screen.
+static inline void ST7789_DrawString(SPI_HandleTypeDef* hspi, uint16_t x, uint16_t y, const char* text,
+                                     uint32_t fg, uint32_t bg) {
+    ST7789_RectTypeDef r;
+    size_t length = strlen(text);
+    if (!length || !ST7789_GFX_Clip(x, y, length * ST7789_FONT_CELL_WIDTH, ST7789_FONT_CELL_HEIGHT, ST7789_GFX_SCREEN, &r))
+        return;
+    ST7789_GFX_StreamTypeDef* stream = ST7789_GFX_Begin(hspi, r);
+    for (uint16_t row = 0; row < r.h; row++) {
+        for (uint16_t col = 0; col < r.w; col++) {
+            uint8_t c = text[col / ST7789_FONT_CELL_WIDTH];
+            uint8_t column = col % ST7789_FONT_CELL_WIDTH;
+            if (c < 0x20 || c > 0x7E)
+                c = '?';
+            bool on = column < ST7789_FONT_WIDTH && (ST7789_FONT_5X7[c - 0x20][column] >> row & 1);
+            ST7789_GFX_Put(stream, on ? fg : bg);
+        }
+    }
+    ST7789_GFX_Flush(stream);
+}